@@ -0,0 +1,233 @@
+#ifndef BENCH_COMMON_H_
+#define BENCH_COMMON_H_
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "corrugate/util/Metrics.hpp"
+
+#include <glm/glm.hpp>
+
+// shared bits for the bench programs
+namespace bench {
+  class Timer {
+   public:
+    Timer() : start_(std::chrono::steady_clock::now()) {}
+
+    double Seconds() const {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+   private:
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  // one field of a result - a number, or a label (mode names etc.)
+  struct Field {
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    Field(const char* key, T number) : key(key), number(static_cast<double>(number)), is_text(false) {}
+    Field(const char* key, const char* text) : key(key), text(text), number(0.0), is_text(true) {}
+
+    const char* key;
+    std::string text;
+    double number;
+    bool is_text;
+  };
+
+  /**
+   * @brief Collects results for machine readable output - run any bench with `--json <path>`
+   *        (or `scons bench-json`) to get them all in one json file, alongside the usual text.
+   *
+   *        {"bench": name, "hardware_threads": n, "metrics_enabled": bool,
+   *         "results": [{"name": ..., "threads": n, <fields>}, ...], "metrics": {...}}
+   *
+   *        "threads" is the number of threads a result actually ran on - results timed on a pool
+   *        pass their pool size, anything else ran on the calling thread alone and gets 1.
+   */
+  class Report {
+   public:
+    static Report& Get() {
+      static Report report;
+      return report;
+    }
+
+    // call first thing in main
+    void Init(int argc, char** argv, const char* bench) {
+      bench_ = bench;
+      for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+          path_ = argv[i + 1];
+        }
+      }
+    }
+
+    void Add(const char* name, std::initializer_list<Field> fields) {
+      std::ostringstream out;
+      out << "{\"name\": " << Quote(name);
+      bool has_threads = false;
+      for (const Field& field : fields) {
+        has_threads = has_threads || strcmp(field.key, "threads") == 0;
+      }
+
+      if (!has_threads) {
+        out << ", \"threads\": 1";
+      }
+
+      for (const Field& field : fields) {
+        out << ", " << Quote(field.key) << ": " << (field.is_text ? Quote(field.text) : Number(field.number));
+      }
+
+      out << "}";
+      results_.push_back(out.str());
+    }
+
+    // writes the json file, if one was asked for
+    bool Write() const {
+      if (path_.empty()) {
+        return true;
+      }
+
+      std::ofstream file(path_);
+      file << "{\"bench\": " << Quote(bench_)
+           << ", \"hardware_threads\": " << std::max(std::thread::hardware_concurrency(), 1U)
+           << ", \"metrics_enabled\": " << (cg::metrics::Metrics::IsEnabled() ? "true" : "false")
+           << ", \"results\": [";
+      for (size_t i = 0; i < results_.size(); i++) {
+        file << (i > 0 ? ",\n  " : "\n  ") << results_[i];
+      }
+
+      file << "\n]";
+      if (cg::metrics::Metrics::IsEnabled()) {
+        cg::metrics::Snapshot snapshot = cg::metrics::Metrics::Get().GetSnapshot();
+        file << ", \"metrics\": {";
+        for (uint32_t i = 0; i < cg::metrics::COUNTER_COUNT; i++) {
+          auto counter = static_cast<cg::metrics::Counter>(i);
+          file << (i > 0 ? ", " : "") << Quote(cg::metrics::GetName(counter)) << ": " << snapshot.Get(counter);
+        }
+
+        for (uint32_t i = 0; i < cg::metrics::STAGE_COUNT; i++) {
+          auto stage = static_cast<cg::metrics::Stage>(i);
+          file << ", " << Quote(std::string(cg::metrics::GetName(stage)) + "_ms") << ": " << Number(snapshot.GetSeconds(stage) * 1e3);
+        }
+
+        file << "}";
+      }
+
+      file << "}" << std::endl;
+      if (!file) {
+        std::cerr << "couldn't write " << path_ << std::endl;
+        return false;
+      }
+
+      return true;
+    }
+
+   private:
+    static std::string Quote(const std::string& text) {
+      std::string res = "\"";
+      for (char c : text) {
+        if (c == '"' || c == '\\') {
+          res += '\\';
+        }
+
+        res += c;
+      }
+
+      return res + "\"";
+    }
+
+    static std::string Number(double value) {
+      if (!std::isfinite(value)) {
+        return "null";
+      }
+
+      std::ostringstream out;
+      out.precision(6);
+      out << value;
+      return out.str();
+    }
+
+    std::string bench_;
+    std::string path_;
+    std::vector<std::string> results_;
+  };
+
+  inline void Init(int argc, char** argv, const char* bench) {
+    Report::Get().Init(argc, argv, bench);
+  }
+
+  inline void Record(const char* name, std::initializer_list<Field> fields) {
+    Report::Get().Add(name, fields);
+  }
+
+  // dumps counters and stage times - only has anything to say with `scons bench metrics=1`
+  inline void PrintMetrics() {
+    if (!cg::metrics::Metrics::IsEnabled()) {
+      return;
+    }
+
+    cg::metrics::Snapshot snapshot = cg::metrics::Metrics::Get().GetSnapshot();
+    std::cout << "metrics:" << std::endl;
+    for (uint32_t i = 0; i < cg::metrics::COUNTER_COUNT; i++) {
+      auto counter = static_cast<cg::metrics::Counter>(i);
+      std::cout << "  " << cg::metrics::GetName(counter) << ": " << snapshot.Get(counter) << std::endl;
+    }
+
+    for (uint32_t i = 0; i < cg::metrics::STAGE_COUNT; i++) {
+      auto stage = static_cast<cg::metrics::Stage>(i);
+      std::cout << "  " << cg::metrics::GetName(stage) << " ms: " << (snapshot.GetSeconds(stage) * 1e3)
+                << ", calls: " << snapshot.stage_calls[i] << std::endl;
+    }
+  }
+
+  // failed Check calls so far
+  inline int& CheckFailures() {
+    static int failures = 0;
+    return failures;
+  }
+
+  // sanity checks next to the timings - a failed check is printed, and makes Finish return nonzero
+  inline bool Check(bool ok, const char* what) {
+    if (!ok) {
+      std::cerr << "check failed: " << what << std::endl;
+      CheckFailures()++;
+    }
+
+    return ok;
+  }
+
+  // call last thing in main - prints metrics, writes json
+  inline int Finish() {
+    PrintMetrics();
+    bool written = Report::Get().Write();
+    return (written && CheckFailures() == 0 ? 0 : 1);
+  }
+
+  // deterministic box placement, so runs are comparable
+  class BoxGen {
+   public:
+    BoxGen(double world_size, double min_size, double max_size, uint32_t seed = 1337)
+    : rng_(seed), pos_(0.0, world_size), size_(min_size, max_size) {}
+
+    glm::dvec2 Origin() { return glm::dvec2(pos_(rng_), pos_(rng_)); }
+    glm::dvec2 Size()   { return glm::dvec2(size_(rng_), size_(rng_)); }
+
+   private:
+    std::mt19937 rng_;
+    std::uniform_real_distribution<double> pos_;
+    std::uniform_real_distribution<double> size_;
+  };
+}
+
+#endif // BENCH_COMMON_H_
@@ -0,0 +1,661 @@
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "corrugate/box/BaseTerrainBox.hpp"
+#include "corrugate/box/SmoothingTerrainBox.hpp"
+#include "corrugate/box/StaticTerrainBox.hpp"
+#include "corrugate/sampler/MultiBoxSampler.hpp"
+#include "corrugate/sampler/SmoothingMultiBoxSampler.hpp"
+#include "corrugate/sampler/splat/SplatManager.hpp"
+
+#include "BenchCommon.hpp"
+
+// whole-chunk vs. blocked compositing in MultiBoxSampler
+// - every box covers the whole chunk, so each one is accumulated everywhere
+// - "est. traffic" assumes the chunk doesn't fit in cache: whole-chunk compositing streams
+//   temp (write + read) and output (read + write) once per box, blocked compositing writes output once
+
+#define CHUNK_SIZE 512
+#define REPEATS 4
+
+struct WaveSampler {
+  float Sample(double x, double y) const {
+    return static_cast<float>(x * 0.001 + y * 0.002);
+  }
+
+  glm::vec4 Sample(double x, double y, size_t) const {
+    return glm::vec4(static_cast<float>(x * 0.001), static_cast<float>(y * 0.001), 0.25f, 0.25f);
+  }
+};
+
+template <typename DataType, typename WriteFunc>
+void BenchLayer(const char* layer, cg::MultiBoxSampler<cg::SamplerBox>& sampler, int boxes, WriteFunc&& write) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  std::vector<DataType> output(elems);
+
+  double times[2];
+  int tile_sizes[2] = { 0, _COMPOSITE_TILE_SIZE };
+  for (int i = 0; i < 2; i++) {
+    sampler.SetTileSize(tile_sizes[i]);
+    bench::Timer timer;
+    for (int r = 0; r < REPEATS; r++) {
+      write(output.data(), elems * sizeof(DataType));
+    }
+
+    times[i] = timer.Seconds() / REPEATS;
+  }
+
+  double chunk_bytes = static_cast<double>(elems * sizeof(DataType));
+  double untiled_traffic = chunk_bytes * 4.0 * boxes;
+  double tiled_traffic = chunk_bytes;
+
+  std::cout << layer
+            << ", boxes: " << boxes
+            << ", whole-chunk ms: " << (times[0] * 1e3)
+            << ", blocked ms: " << (times[1] * 1e3)
+            << ", est. traffic MB: " << (untiled_traffic / 1e6) << " -> " << (tiled_traffic / 1e6)
+            << ", est. saved MB: " << ((untiled_traffic - tiled_traffic) / 1e6) << std::endl;
+
+  bench::Record("blocked", {
+    { "layer", layer },
+    { "boxes", boxes },
+    { "whole_chunk_ms", times[0] * 1e3 },
+    { "blocked_ms", times[1] * 1e3 }
+  });
+}
+
+// long generation loop - workspace should stop growing after the first chunk, and rss should stay flat
+void BenchSteadyState(cg::MultiBoxSampler<cg::SamplerBox>& sampler) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  std::vector<float> height(elems);
+  std::vector<glm::vec4> splat(elems);
+  cg::Workspace workspace;
+
+  for (int chunk = 0; chunk < 256; chunk++) {
+    glm::dvec2 origin(0.0, (chunk % 4) * 8.0);
+    sampler.WriteHeight(origin, glm::ivec2(CHUNK_SIZE), 1.0, height.data(), elems * sizeof(float), &workspace);
+    sampler.WriteSplat(origin, glm::ivec2(CHUNK_SIZE), 1.0, 0, splat.data(), elems * sizeof(glm::vec4), &workspace);
+    sampler.WriteTreeFill(origin, glm::ivec2(CHUNK_SIZE), 1.0, height.data(), elems * sizeof(float), &workspace);
+
+    if ((chunk & 63) == 0 || chunk == 255) {
+      rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      std::cout << "chunk: " << chunk
+                << ", workspace allocs: " << workspace.GetAllocationCount()
+                << ", workspace bytes: " << workspace.GetCapacity()
+                << ", max rss: " << usage.ru_maxrss << std::endl;
+
+      bench::Record("steady_state", {
+        { "chunk", chunk },
+        { "workspace_allocs", workspace.GetAllocationCount() },
+        { "workspace_bytes", workspace.GetCapacity() },
+        { "max_rss_kb", usage.ru_maxrss }
+      });
+    }
+  }
+}
+
+// per-sample GetFalloffWeight vs. the row kernel, over a whole chunk
+void BenchFalloff(const cg::SamplerBox& box) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  std::vector<float> output(elems);
+
+  bench::Timer scalar_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        output[y * CHUNK_SIZE + x] = box.GetFalloffWeight(glm::dvec2(x, y));
+      }
+    }
+  }
+
+  double scalar_time = scalar_timer.Seconds() / REPEATS;
+  float scalar_sum = 0.0f;
+  for (float f : output) {
+    scalar_sum += f;
+  }
+
+  bench::Timer row_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      box.WriteFalloffRow(glm::dvec2(0.0, y), 1.0, CHUNK_SIZE, output.data() + y * CHUNK_SIZE);
+    }
+  }
+
+  double row_time = row_timer.Seconds() / REPEATS;
+  float row_sum = 0.0f;
+  for (float f : output) {
+    row_sum += f;
+  }
+
+  std::cout << "falloff"
+            << ", per-sample ms: " << (scalar_time * 1e3)
+            << ", row kernel ms: " << (row_time * 1e3)
+            << ", speedup: " << (scalar_time / row_time)
+            << ", sum: " << scalar_sum << " / " << row_sum << std::endl;
+
+  bench::Record("falloff", {
+    { "per_sample_ms", scalar_time * 1e3 },
+    { "row_kernel_ms", row_time * 1e3 }
+  });
+}
+
+// single box write, with the box covering a shrinking corner of the chunk
+// - time should follow covered area, not chunk area
+void BenchCoverage(const std::shared_ptr<WaveSampler>& wave) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  std::vector<float> output(elems);
+
+  for (double fraction : { 1.0, 0.5, 0.25, 0.125 }) {
+    double box_size = CHUNK_SIZE * fraction;
+    cg::BaseTerrainBox box(glm::dvec2(CHUNK_SIZE - box_size), glm::dvec2(box_size), wave, wave, wave, 1.0f, 0.5f);
+
+    bench::Timer timer;
+    for (int r = 0; r < REPEATS; r++) {
+      box.WriteHeight(glm::dvec2(0.0), glm::ivec2(CHUNK_SIZE), 1.0, output.data(), elems * sizeof(float));
+    }
+
+    double time = timer.Seconds() / REPEATS;
+    std::cout << "coverage: " << (fraction * fraction)
+              << ", box write ms: " << (time * 1e3) << std::endl;
+
+    bench::Record("coverage", {
+      { "coverage", fraction * fraction },
+      { "ms", time * 1e3 }
+    });
+  }
+}
+
+// four splat layers + tree fill for one chunk: falloff sum per layer vs. once per chunk
+void BenchContext(cg::MultiBoxSampler<cg::SamplerBox>& sampler, int boxes) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  std::vector<glm::vec4> splat(elems);
+  std::vector<float> fill(elems);
+  glm::dvec2 origin(0.0);
+  glm::ivec2 dims(CHUNK_SIZE);
+  cg::Workspace workspace;
+
+  bench::Timer layer_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    for (size_t i = 0; i < 4; i++) {
+      sampler.WriteSplat(origin, dims, 1.0, i, splat.data(), elems * sizeof(glm::vec4), &workspace);
+    }
+
+    sampler.WriteTreeFill(origin, dims, 1.0, fill.data(), elems * sizeof(float), &workspace);
+  }
+
+  double layer_time = layer_timer.Seconds() / REPEATS;
+
+  bench::Timer context_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    cg::Workspace::Scope scope(workspace);
+    cg::ChunkContext context(origin, dims, 1.0, workspace);
+    sampler.PrepareContext(context);
+    for (size_t i = 0; i < 4; i++) {
+      sampler.WriteSplat(context, i, splat.data(), elems * sizeof(glm::vec4));
+    }
+
+    sampler.WriteTreeFill(context, fill.data(), elems * sizeof(float));
+  }
+
+  double context_time = context_timer.Seconds() / REPEATS;
+
+  std::cout << "context, boxes: " << boxes
+            << ", per-layer falloffs ms: " << (layer_time * 1e3)
+            << ", shared context ms: " << (context_time * 1e3) << std::endl;
+
+  bench::Record("context", {
+    { "boxes", boxes },
+    { "per_layer_ms", layer_time * 1e3 },
+    { "shared_context_ms", context_time * 1e3 }
+  });
+}
+
+// height + four splat layers + tree fill: one call per layer vs. one WriteLayers call
+void BenchLayers(cg::MultiBoxSampler<cg::SamplerBox>& sampler, int boxes) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  std::vector<float> height(elems);
+  std::vector<glm::vec4> splat(elems * 4);
+  std::vector<float> fill(elems);
+  glm::dvec2 origin(0.0);
+  glm::ivec2 dims(CHUNK_SIZE);
+  cg::Workspace workspace;
+
+  bench::Timer separate_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    sampler.WriteHeight(origin, dims, 1.0, height.data(), elems * sizeof(float), &workspace);
+    for (size_t i = 0; i < 4; i++) {
+      sampler.WriteSplat(origin, dims, 1.0, i, splat.data() + i * elems, elems * sizeof(glm::vec4), &workspace);
+    }
+
+    sampler.WriteTreeFill(origin, dims, 1.0, fill.data(), elems * sizeof(float), &workspace);
+  }
+
+  double separate_time = separate_timer.Seconds() / REPEATS;
+
+  cg::ChunkLayers layers;
+  layers.mask = cg::LAYER_ALL;
+  layers.height = height.data();
+  layers.splat = splat.data();
+  layers.splat_count = 4;
+  layers.tree_fill = fill.data();
+
+  bench::Timer layers_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    sampler.WriteLayers(origin, dims, 1.0, layers, &workspace);
+  }
+
+  double layers_time = layers_timer.Seconds() / REPEATS;
+
+  std::cout << "layers, boxes: " << boxes
+            << ", separate ms: " << (separate_time * 1e3)
+            << ", single pass ms: " << (layers_time * 1e3)
+            << ", speedup: " << (separate_time / layers_time) << std::endl;
+
+  bench::Record("layers", {
+    { "boxes", boxes },
+    { "separate_ms", separate_time * 1e3 },
+    { "single_pass_ms", layers_time * 1e3 }
+  });
+}
+
+// type erased vs. static sampler dispatch, one box covering the chunk
+void BenchDispatch(const std::shared_ptr<WaveSampler>& wave) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  std::vector<float> height(elems);
+  std::vector<glm::vec4> splat(elems);
+
+  cg::BaseTerrainBox erased(glm::dvec2(-8.0), glm::dvec2(CHUNK_SIZE + 16.0), wave, wave, wave, 1.0f, 0.5f);
+  cg::StaticTerrainBox<WaveSampler, WaveSampler, WaveSampler> inlined(glm::dvec2(-8.0), glm::dvec2(CHUNK_SIZE + 16.0), wave, wave, wave, 1.0f, 0.5f);
+
+  const cg::SamplerBox* boxes[2] = { &erased, &inlined };
+  const char* names[2] = { "type erased", "static" };
+  for (int i = 0; i < 2; i++) {
+    bench::Timer timer;
+    for (int r = 0; r < REPEATS; r++) {
+      boxes[i]->WriteHeight(glm::dvec2(0.0), glm::ivec2(CHUNK_SIZE), 1.0, height.data(), elems * sizeof(float));
+      boxes[i]->WriteSplat(glm::dvec2(0.0), glm::ivec2(CHUNK_SIZE), 1.0, 0, splat.data(), elems * sizeof(glm::vec4), nullptr);
+    }
+
+    float sum = 0.0f;
+    for (size_t c = 0; c < elems; c++) {
+      sum += height[c] + splat[c].x;
+    }
+
+    double time = timer.Seconds() / REPEATS;
+    std::cout << "dispatch: " << names[i]
+              << ", height + splat ms: " << (time * 1e3)
+              << ", sum: " << sum << std::endl;
+
+    bench::Record("dispatch", {
+      { "dispatch", names[i] },
+      { "ms", time * 1e3 }
+    });
+  }
+}
+
+struct ChannelSampler {
+  float Sample(double x, double y) const {
+    return static_cast<float>(x * 0.001 * k + y * 0.002);
+  }
+
+  float k;
+};
+
+// all layers as floats, converted afterwards vs. quantized while compositing
+void BenchQuantized(cg::MultiBoxSampler<cg::SamplerBox>& sampler, int boxes) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  std::vector<float> height(elems);
+  std::vector<glm::vec4> splat(elems * 4);
+  std::vector<float> fill(elems);
+  std::vector<uint16_t> height_q(elems);
+  std::vector<uint8_t> splat_q(elems * 16);
+  std::vector<uint8_t> fill_q(elems);
+  glm::dvec2 origin(0.0);
+  glm::ivec2 dims(CHUNK_SIZE);
+  cg::Workspace workspace;
+
+  cg::ChunkLayers layers;
+  layers.mask = cg::LAYER_ALL;
+  layers.height = height.data();
+  layers.splat = splat.data();
+  layers.splat_count = 4;
+  layers.tree_fill = fill.data();
+
+  cg::QuantizedChunkLayers quantized;
+  quantized.mask = cg::LAYER_ALL;
+  quantized.height = height_q.data();
+  quantized.height_min = -64.0f;
+  quantized.height_max = 64.0f;
+  quantized.splat = splat_q.data();
+  quantized.splat_count = 4;
+  quantized.tree_fill = fill_q.data();
+
+  bench::Timer float_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    sampler.WriteLayers(origin, dims, 1.0, layers, &workspace);
+    quantized.QuantizeHeight(height.data(), static_cast<int>(elems), height_q.data());
+    cg::QuantizedChunkLayers::QuantizeSplat(splat.data(), static_cast<int>(elems * 4), splat_q.data());
+    cg::QuantizedChunkLayers::QuantizeTreeFill(fill.data(), static_cast<int>(elems), fill_q.data());
+  }
+
+  double float_time = float_timer.Seconds() / REPEATS;
+
+  bench::Timer quantized_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    sampler.WriteLayers(origin, dims, 1.0, quantized, &workspace);
+  }
+
+  double quantized_time = quantized_timer.Seconds() / REPEATS;
+
+  std::cout << "quantized, boxes: " << boxes
+            << ", float + convert ms: " << (float_time * 1e3)
+            << ", quantized ms: " << (quantized_time * 1e3)
+            << ", output MB: " << (layers.GetByteCount(dims) / 1e6) << " -> " << (quantized.GetByteCount(dims) / 1e6) << std::endl;
+
+  bench::Record("quantized", {
+    { "boxes", boxes },
+    { "float_convert_ms", float_time * 1e3 },
+    { "quantized_ms", quantized_time * 1e3 },
+    { "float_bytes", layers.GetByteCount(dims) },
+    { "quantized_bytes", quantized.GetByteCount(dims) }
+  });
+}
+
+// four splat layers sharing three channel samplers: one WriteSampler per layer vs. WriteSamplers
+void BenchSplatLayers() {
+  auto a = std::make_shared<ChannelSampler>(ChannelSampler { 1.0f });
+  auto b = std::make_shared<ChannelSampler>(ChannelSampler { 2.0f });
+  auto c = std::make_shared<ChannelSampler>(ChannelSampler { 3.0f });
+
+  cg::SplatManager manager;
+  manager.BindSamplers(a, b, c, a, 0);
+  manager.BindSamplers(b, c, a, b, 1);
+  manager.BindSamplers(c, a, b, c, 2);
+  manager.BindSamplers(a, a, b, b, 3);
+
+  glm::ivec2 size(CHUNK_SIZE);
+  size_t plane = static_cast<size_t>(CHUNK_SIZE) * CHUNK_SIZE * 4;
+  std::vector<float> output(plane * 4);
+
+  bench::Timer single_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    for (size_t i = 0; i < 4; i++) {
+      manager.WriteSampler(size, glm::dvec2(0.0), glm::dvec2(1.0), output.data() + i * plane, i);
+    }
+  }
+
+  double single_time = single_timer.Seconds() / REPEATS;
+
+  bench::Timer layered_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    manager.WriteAllSamplers(size, glm::dvec2(0.0), glm::dvec2(1.0), output.data());
+  }
+
+  double layered_time = layered_timer.Seconds() / REPEATS;
+
+  std::cout << "splat manager, 4 layers"
+            << ", per layer ms: " << (single_time * 1e3)
+            << ", layered ms: " << (layered_time * 1e3)
+            << ", speedup: " << (single_time / layered_time) << std::endl;
+
+  bench::Record("splat_layers", {
+    { "per_layer_ms", single_time * 1e3 },
+    { "layered_ms", layered_time * 1e3 }
+  });
+}
+
+// one splat layer: interleaved rgba vs. one pass per channel plane, and planar + interleave for rgba consumers
+void BenchPlanar() {
+  auto a = std::make_shared<ChannelSampler>(ChannelSampler { 1.0f });
+  auto b = std::make_shared<ChannelSampler>(ChannelSampler { 2.0f });
+
+  cg::SplatManager manager;
+  manager.BindSamplers(a, b, a, b, 0);
+
+  glm::ivec2 size(CHUNK_SIZE);
+  size_t plane = static_cast<size_t>(CHUNK_SIZE) * CHUNK_SIZE;
+  std::vector<float> output(plane * 4);
+  std::vector<float> rgba(plane * 4);
+
+  bench::Timer interleaved_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    manager.WriteSampler(size, glm::dvec2(0.0), glm::dvec2(1.0), rgba.data(), 0);
+  }
+
+  double interleaved_time = interleaved_timer.Seconds() / REPEATS;
+
+  bench::Timer planar_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    manager.WriteSamplerPlanar(size, glm::dvec2(0.0), glm::dvec2(1.0), output.data(), 0);
+  }
+
+  double planar_time = planar_timer.Seconds() / REPEATS;
+
+  bench::Timer interleave_timer;
+  for (int r = 0; r < REPEATS; r++) {
+    cg::simd::Interleave4(output.data(), output.data() + plane, output.data() + plane * 2, output.data() + plane * 3, static_cast<int>(plane), rgba.data());
+  }
+
+  double interleave_time = interleave_timer.Seconds() / REPEATS;
+
+  std::cout << "splat planar"
+            << ", interleaved ms: " << (interleaved_time * 1e3)
+            << ", planar ms: " << (planar_time * 1e3)
+            << ", interleave ms: " << (interleave_time * 1e3) << std::endl;
+
+  bench::Record("splat_planar", {
+    { "interleaved_ms", interleaved_time * 1e3 },
+    { "planar_ms", planar_time * 1e3 },
+    { "interleave_ms", interleave_time * 1e3 }
+  });
+}
+
+struct BulkChannelSampler {
+  float Sample(double x, double y) const {
+    return static_cast<float>(x * 0.001 * k + y * 0.002);
+  }
+
+  // whole image at once - picked up by SplatManager through channel_chunk_trait
+  void Write(const glm::ivec2& size, const glm::dvec2& start, const glm::dvec2& scale, float* output) const {
+    for (int y = 0; y < size.y; y++) {
+      float row = static_cast<float>((start.y + y * scale.y) * 0.002);
+      float step = static_cast<float>(scale.x * 0.001 * k);
+      float base = static_cast<float>(start.x * 0.001 * k) + row;
+      for (int x = 0; x < size.x; x++) {
+        output[y * size.x + x] = base + x * step;
+      }
+    }
+  }
+
+  float k;
+};
+
+// SplatManager::WriteSampler with channel samplers sampled per pixel vs. written in bulk
+void BenchSplatBulk() {
+  auto single = std::make_shared<ChannelSampler>(ChannelSampler { 1.0f });
+  auto bulk = std::make_shared<BulkChannelSampler>(BulkChannelSampler { 1.0f });
+
+  cg::SplatManager managers[2];
+  managers[0].BindSamplers(single, single, single, single, 0);
+  managers[1].BindSamplers(bulk, bulk, bulk, bulk, 0);
+
+  glm::ivec2 size(CHUNK_SIZE);
+  std::vector<float> output(static_cast<size_t>(CHUNK_SIZE) * CHUNK_SIZE * 4);
+
+  double times[2];
+  for (int i = 0; i < 2; i++) {
+    bench::Timer timer;
+    for (int r = 0; r < REPEATS; r++) {
+      managers[i].WriteSampler(size, glm::dvec2(0.0), glm::dvec2(1.0), output.data(), 0);
+    }
+
+    times[i] = timer.Seconds() / REPEATS;
+  }
+
+  std::cout << "splat sampler"
+            << ", per-pixel ms: " << (times[0] * 1e3)
+            << ", bulk ms: " << (times[1] * 1e3)
+            << ", speedup: " << (times[0] / times[1]) << std::endl;
+
+  bench::Record("splat_sampler", {
+    { "per_pixel_ms", times[0] * 1e3 },
+    { "bulk_ms", times[1] * 1e3 }
+  });
+}
+
+// staggered boxes, each a little larger than the chunk - every sample sees depth boxes
+std::vector<std::shared_ptr<const cg::SamplerBox>> MakeOverlap(const std::shared_ptr<WaveSampler>& wave, int chunk_size, int depth) {
+  std::vector<std::shared_ptr<const cg::SamplerBox>> contents;
+  for (int i = 0; i < depth; i++) {
+    glm::dvec2 box_origin(-8.0 - i, -8.0 - i);
+    contents.push_back(std::make_shared<cg::BaseTerrainBox>(box_origin, glm::dvec2(chunk_size + 16.0 + 2.0 * i), wave, wave, wave, 1.0f, 0.5f));
+  }
+
+  return contents;
+}
+
+// every MultiBoxSampler layer write, over chunk size x overlap depth
+void BenchChunkSizes(const std::shared_ptr<WaveSampler>& wave) {
+  for (int chunk_size : { 64, 128, 256, 512, 1024 }) {
+    size_t elems = static_cast<size_t>(chunk_size) * chunk_size;
+    std::vector<float> height(elems);
+    std::vector<glm::vec4> splat(elems);
+    glm::ivec2 dims(chunk_size);
+    cg::Workspace workspace;
+
+    for (int depth : { 1, 8, 32 }) {
+      cg::MultiBoxSampler<cg::SamplerBox> sampler(MakeOverlap(wave, chunk_size, depth));
+      // same amount of work per size, roughly
+      int repeats = std::max(REPEATS * (CHUNK_SIZE * CHUNK_SIZE) / static_cast<int>(elems), 1);
+
+      double times[3];
+      for (int layer = 0; layer < 3; layer++) {
+        bench::Timer timer;
+        for (int r = 0; r < repeats; r++) {
+          if (layer == 0) {
+            sampler.WriteHeight(glm::dvec2(0.0), dims, 1.0, height.data(), elems * sizeof(float), &workspace);
+          } else if (layer == 1) {
+            sampler.WriteSplat(glm::dvec2(0.0), dims, 1.0, 0, splat.data(), elems * sizeof(glm::vec4), &workspace);
+          } else {
+            sampler.WriteTreeFill(glm::dvec2(0.0), dims, 1.0, height.data(), elems * sizeof(float), &workspace);
+          }
+        }
+
+        times[layer] = timer.Seconds() / repeats;
+      }
+
+      std::cout << "chunk: " << chunk_size
+                << ", depth: " << depth
+                << ", height ns/sample: " << (times[0] * 1e9 / elems)
+                << ", splat ns/sample: " << (times[1] * 1e9 / elems)
+                << ", tree fill ns/sample: " << (times[2] * 1e9 / elems) << std::endl;
+
+      bench::Record("chunk_write", {
+        { "chunk_size", chunk_size },
+        { "depth", depth },
+        { "height_ns_per_sample", times[0] * 1e9 / elems },
+        { "splat_ns_per_sample", times[1] * 1e9 / elems },
+        { "tree_fill_ns_per_sample", times[2] * 1e9 / elems }
+      });
+    }
+  }
+}
+
+// SmoothingMultiBoxSampler::WriteHeight vs. the plain height write, over overlap depth
+void BenchSmoothing(const std::shared_ptr<WaveSampler>& wave) {
+  size_t elems = CHUNK_SIZE * CHUNK_SIZE;
+  glm::ivec2 dims(CHUNK_SIZE);
+  std::vector<float> height(elems);
+  std::vector<float> underlying(elems, 1.0f);
+  cg::DataSampler<float> base(dims, underlying.data());
+  cg::Workspace workspace;
+
+  for (int depth : { 1, 4, 16 }) {
+    std::vector<std::shared_ptr<const cg::SmoothingTerrainBox>> contents;
+    std::vector<std::shared_ptr<const cg::SamplerBox>> plain;
+    for (int i = 0; i < depth; i++) {
+      auto box = std::make_shared<cg::SmoothingTerrainBox>(glm::dvec2(-8.0 - i), glm::dvec2(CHUNK_SIZE + 16.0 + 2.0 * i), wave, wave, wave, 1.0f, 0.5f, 0.5f);
+      box->PrepareCache(wave);
+      contents.push_back(box);
+      plain.push_back(box);
+    }
+
+    cg::SmoothingMultiBoxSampler<cg::SmoothingTerrainBox> smoothing(contents);
+    cg::MultiBoxSampler<cg::SamplerBox> sampler(plain);
+
+    bench::Timer plain_timer;
+    for (int r = 0; r < REPEATS; r++) {
+      sampler.WriteHeight(glm::dvec2(0.0), dims, 1.0, height.data(), elems * sizeof(float), &workspace);
+    }
+
+    double plain_time = plain_timer.Seconds() / REPEATS;
+
+    bench::Timer smoothing_timer;
+    for (int r = 0; r < REPEATS; r++) {
+      smoothing.WriteHeight(glm::dvec2(0.0), dims, 1.0, base, height.data(), elems * sizeof(float), &workspace);
+    }
+
+    double smoothing_time = smoothing_timer.Seconds() / REPEATS;
+
+    std::cout << "smoothing, depth: " << depth
+              << ", plain height ms: " << (plain_time * 1e3)
+              << ", smoothed height ms: " << (smoothing_time * 1e3) << std::endl;
+
+    bench::Record("smoothing_height", {
+      { "depth", depth },
+      { "plain_ms", plain_time * 1e3 },
+      { "smoothed_ms", smoothing_time * 1e3 }
+    });
+  }
+}
+
+int main(int argc, char** argv) {
+  bench::Init(argc, argv, "CompositeBench");
+
+  auto wave = std::make_shared<WaveSampler>();
+  glm::dvec2 origin(0.0);
+  glm::ivec2 dims(CHUNK_SIZE);
+
+  BenchCoverage(wave);
+  BenchDispatch(wave);
+  BenchSplatLayers();
+  BenchPlanar();
+  BenchSplatBulk();
+  BenchChunkSizes(wave);
+  BenchSmoothing(wave);
+
+  for (int boxes : { 1, 4, 16, 64 }) {
+    std::vector<std::shared_ptr<const cg::SamplerBox>> contents = MakeOverlap(wave, CHUNK_SIZE, boxes);
+    cg::MultiBoxSampler<cg::SamplerBox> sampler(contents);
+
+    BenchLayer<float>("height", sampler, boxes, [&](float* output, size_t bytes) {
+      sampler.WriteHeight(origin, dims, 1.0, output, bytes);
+    });
+
+    BenchLayer<glm::vec4>("splat", sampler, boxes, [&](glm::vec4* output, size_t bytes) {
+      sampler.WriteSplat(origin, dims, 1.0, 0, output, bytes);
+    });
+
+    BenchLayer<float>("tree fill", sampler, boxes, [&](float* output, size_t bytes) {
+      sampler.WriteTreeFill(origin, dims, 1.0, output, bytes);
+    });
+
+    BenchContext(sampler, boxes);
+    BenchLayers(sampler, boxes);
+    BenchQuantized(sampler, boxes);
+
+    if (boxes == 1) {
+      BenchFalloff(*contents[0]);
+    }
+
+    if (boxes == 4) {
+      BenchSteadyState(sampler);
+    }
+  }
+
+  return bench::Finish();
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "corrugate/MultiSampler.hpp"
+
+#include "BenchCommon.hpp"
+
+// insert + fetch latency vs box count, then fetch throughput vs thread count
+// - reader threads hammer FetchRange while one writer keeps inserting/removing boxes
+
+#define WORLD_SIZE 16384.0
+#define BOX_COUNT 4096
+#define RUN_SECONDS 1.0
+#define LATENCY_QUERIES 100000
+#define LATENCY_EDITS 256
+
+void BenchLatency(size_t box_count) {
+  // world grows w box count so box density stays constant
+  double world_size = WORLD_SIZE * std::sqrt(box_count / static_cast<double>(BOX_COUNT));
+  cg::MultiSampler<cg::FeatureBox> sampler;
+  bench::BoxGen gen(world_size, 16.0, 512.0);
+  bench::Timer insert_timer;
+  for (size_t i = 0; i < box_count; i++) {
+    sampler.InsertBox<cg::FeatureBox>(gen.Origin(), gen.Size());
+  }
+
+  double insert_time = insert_timer.Seconds();
+
+  // same boxes, one publish
+  cg::MultiSampler<cg::FeatureBox> batched;
+  bench::BoxGen batch_gen(world_size, 16.0, 512.0);
+  bench::Timer batch_timer;
+  {
+    cg::MultiSampler<cg::FeatureBox>::EditScope scope(batched);
+    for (size_t i = 0; i < box_count; i++) {
+      batched.InsertBox<cg::FeatureBox>(batch_gen.Origin(), batch_gen.Size());
+    }
+  }
+
+  double batch_time = batch_timer.Seconds();
+
+  // one more edit on a full sampler - what a live edit costs
+  bench::Timer edit_timer;
+  for (int i = 0; i < LATENCY_EDITS; i++) {
+    sampler.RemoveBox(sampler.InsertBox<cg::FeatureBox>(gen.Origin(), gen.Size()));
+  }
+
+  double edit_time = edit_timer.Seconds();
+
+  // hits per query stay constant, so ideally this stays flat
+  bench::BoxGen query_gen(world_size, 64.0, 256.0, 7);
+  auto snapshot = sampler.GetSnapshot();
+  size_t hits = 0;
+  bench::Timer timer;
+  for (int i = 0; i < LATENCY_QUERIES; i++) {
+    snapshot->ForEach(query_gen.Origin(), query_gen.Size(), [&](uint32_t, const std::shared_ptr<cg::FeatureBox>&) {
+      hits++;
+    });
+  }
+
+  double elapsed = timer.Seconds();
+  std::cout << "boxes: " << box_count
+            << ", ns/insert: " << (insert_time * 1e9 / box_count)
+            << ", ns/batched insert: " << (batch_time * 1e9 / box_count)
+            << ", ns/edit (insert + remove): " << (edit_time * 1e9 / LATENCY_EDITS)
+            << ", ns/fetch: " << (elapsed * 1e9 / LATENCY_QUERIES)
+            << ", avg hits: " << (hits / static_cast<double>(LATENCY_QUERIES))
+            << ", index bytes: " << snapshot->GetMemoryUsage() << std::endl;
+
+  bench::Record("latency", {
+    { "boxes", box_count },
+    { "ns_per_insert", insert_time * 1e9 / box_count },
+    { "ns_per_batched_insert", batch_time * 1e9 / box_count },
+    { "ns_per_edit", edit_time * 1e9 / LATENCY_EDITS },
+    { "ns_per_fetch", elapsed * 1e9 / LATENCY_QUERIES },
+    { "avg_hits", hits / static_cast<double>(LATENCY_QUERIES) },
+    { "index_bytes", snapshot->GetMemoryUsage() }
+  });
+}
+
+// tiling a region: one set-based FetchRange per tile vs. one batched call
+void BenchBatch(size_t tiles_per_side) {
+  cg::MultiSampler<cg::FeatureBox> sampler;
+  bench::BoxGen gen(WORLD_SIZE, 16.0, 512.0);
+  for (int i = 0; i < BOX_COUNT; i++) {
+    sampler.InsertBox<cg::FeatureBox>(gen.Origin(), gen.Size());
+  }
+
+  double tile_size = WORLD_SIZE / tiles_per_side;
+  std::vector<glm::dvec2> origins;
+  std::vector<glm::dvec2> sizes;
+  for (size_t y = 0; y < tiles_per_side; y++) {
+    for (size_t x = 0; x < tiles_per_side; x++) {
+      origins.push_back(glm::dvec2(x * tile_size, y * tile_size));
+      sizes.push_back(glm::dvec2(tile_size));
+    }
+  }
+
+  size_t set_hits = 0;
+  bench::Timer set_timer;
+  for (size_t i = 0; i < origins.size(); i++) {
+    cg::MultiSampler<cg::FeatureBox>::output_type output;
+    sampler.FetchRange(origins[i], sizes[i], output);
+    set_hits += output.size();
+  }
+
+  double set_time = set_timer.Seconds();
+
+  cg::MultiSampler<cg::FeatureBox>::FetchBatch batch;
+  // warm up buffers - steady state is what we care about
+  sampler.FetchRanges(origins.data(), sizes.data(), origins.size(), batch);
+  bench::Timer batch_timer;
+  sampler.FetchRanges(origins.data(), sizes.data(), origins.size(), batch);
+  double batch_time = batch_timer.Seconds();
+
+  std::cout << "tiles: " << origins.size()
+            << ", set ns/tile: " << (set_time * 1e9 / origins.size())
+            << ", batch ns/tile: " << (batch_time * 1e9 / origins.size())
+            << ", hits: " << set_hits
+            << ", unique: " << batch.GetUnique().size() << std::endl;
+
+  bench::Record("batch", {
+    { "tiles", origins.size() },
+    { "set_ns_per_tile", set_time * 1e9 / origins.size() },
+    { "batch_ns_per_tile", batch_time * 1e9 / origins.size() },
+    { "hits", set_hits }
+  });
+}
+
+int main(int argc, char** argv) {
+  bench::Init(argc, argv, "FetchBench");
+
+  for (size_t box_count = 1024; box_count <= 65536; box_count *= 4) {
+    BenchLatency(box_count);
+  }
+
+  for (size_t tiles_per_side = 16; tiles_per_side <= 128; tiles_per_side *= 2) {
+    BenchBatch(tiles_per_side);
+  }
+
+  cg::MultiSampler<cg::FeatureBox> sampler;
+  bench::BoxGen gen(WORLD_SIZE, 16.0, 512.0);
+  for (int i = 0; i < BOX_COUNT; i++) {
+    sampler.InsertBox<cg::FeatureBox>(gen.Origin(), gen.Size());
+  }
+
+  unsigned int max_threads = std::max(std::thread::hardware_concurrency(), 1U);
+  for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> fetches(0);
+    std::vector<std::thread> readers;
+
+    for (unsigned int t = 0; t < threads; t++) {
+      readers.emplace_back([&, t]() {
+        bench::BoxGen query_gen(WORLD_SIZE, 64.0, 256.0, t + 1);
+        cg::MultiSampler<cg::FeatureBox>::output_type output;
+        uint64_t local = 0;
+        while (running.load(std::memory_order_relaxed)) {
+          output.clear();
+          sampler.FetchRange(query_gen.Origin(), query_gen.Size(), output);
+          local++;
+        }
+
+        fetches += local;
+      });
+    }
+
+    // writer churn - readers should never wait on this
+    std::thread writer([&]() {
+      bench::BoxGen churn_gen(WORLD_SIZE, 16.0, 512.0, 4242);
+      while (running.load(std::memory_order_relaxed)) {
+        auto box = sampler.InsertBox<cg::FeatureBox>(churn_gen.Origin(), churn_gen.Size());
+        sampler.RemoveBox(box);
+      }
+    });
+
+    bench::Timer timer;
+    std::this_thread::sleep_for(std::chrono::duration<double>(RUN_SECONDS));
+    running = false;
+    for (auto& reader : readers) {
+      reader.join();
+    }
+
+    writer.join();
+    double elapsed = timer.Seconds();
+
+    std::cout << "threads: " << threads
+              << ", fetches/sec: " << (fetches.load() / elapsed)
+              << ", version: " << sampler.GetVersion() << std::endl;
+
+    bench::Record("throughput", {
+      { "threads", threads },
+      { "fetches_per_sec", fetches.load() / elapsed }
+    });
+  }
+
+  return bench::Finish();
+}
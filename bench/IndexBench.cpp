@@ -0,0 +1,81 @@
+#include <iostream>
+#include <string>
+
+#include "corrugate/MultiSampler.hpp"
+
+#include "BenchCommon.hpp"
+
+// grid vs quadtree: memory, insert time, query time
+// - "uniform": lots of hole-sized boxes
+// - "course": same, plus a handful of whole-course boxes spanning hundreds of grid cells
+
+#define WORLD_SIZE 32768.0
+#define BOX_COUNT 16384
+#define COURSE_BOX_COUNT 16
+#define QUERY_COUNT 100000
+
+const char* ModeName(cg::IndexMode mode) {
+  return (mode == cg::IndexMode::QUADTREE ? "quadtree" : "grid");
+}
+
+void BenchIndex(cg::IndexMode mode, bool course_boxes, double query_size) {
+  cg::MultiSampler<cg::FeatureBox> sampler(mode);
+  bench::BoxGen gen(WORLD_SIZE, 16.0, 256.0);
+
+  bench::Timer insert_timer;
+  for (int i = 0; i < BOX_COUNT; i++) {
+    sampler.InsertBox<cg::FeatureBox>(gen.Origin(), gen.Size());
+  }
+
+  if (course_boxes) {
+    bench::BoxGen course_gen(WORLD_SIZE * 0.25, WORLD_SIZE * 0.25, WORLD_SIZE * 0.75, 99);
+    for (int i = 0; i < COURSE_BOX_COUNT; i++) {
+      sampler.InsertBox<cg::FeatureBox>(course_gen.Origin(), course_gen.Size());
+    }
+  }
+
+  double insert_time = insert_timer.Seconds();
+
+  auto snapshot = sampler.GetSnapshot();
+  bench::BoxGen query_gen(WORLD_SIZE, query_size, query_size, 7);
+  size_t hits = 0;
+  bench::Timer query_timer;
+  for (int i = 0; i < QUERY_COUNT; i++) {
+    snapshot->ForEach(query_gen.Origin(), query_gen.Size(), [&](uint32_t, const std::shared_ptr<cg::FeatureBox>&) {
+      hits++;
+    });
+  }
+
+  double query_time = query_timer.Seconds();
+
+  std::cout << ModeName(mode)
+            << ", boxes: " << (course_boxes ? "course" : "uniform")
+            << ", query size: " << query_size
+            << ", index bytes: " << snapshot->GetMemoryUsage()
+            << ", insert ms: " << (insert_time * 1e3)
+            << ", ns/query: " << (query_time * 1e9 / QUERY_COUNT)
+            << ", avg hits: " << (hits / static_cast<double>(QUERY_COUNT)) << std::endl;
+
+  bench::Record("index", {
+    { "mode", ModeName(mode) },
+    { "boxes", (course_boxes ? "course" : "uniform") },
+    { "query_size", query_size },
+    { "index_bytes", snapshot->GetMemoryUsage() },
+    { "insert_ms", insert_time * 1e3 },
+    { "ns_per_query", query_time * 1e9 / QUERY_COUNT },
+    { "avg_hits", hits / static_cast<double>(QUERY_COUNT) }
+  });
+}
+
+int main(int argc, char** argv) {
+  bench::Init(argc, argv, "IndexBench");
+
+  for (bool course_boxes : { false, true }) {
+    for (double query_size : { 32.0, 512.0 }) {
+      BenchIndex(cg::IndexMode::GRID, course_boxes, query_size);
+      BenchIndex(cg::IndexMode::QUADTREE, course_boxes, query_size);
+    }
+  }
+
+  return bench::Finish();
+}
@@ -0,0 +1,766 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "corrugate/box/BaseTerrainBox.hpp"
+#include "corrugate/box/SmoothingTerrainBox.hpp"
+#include "corrugate/region/EditJournal.hpp"
+#include "corrugate/region/MipPyramid.hpp"
+#include "corrugate/region/RegionGenerator.hpp"
+#include "corrugate/region/RegionStream.hpp"
+#include "corrugate/region/TileArchive.hpp"
+#include "corrugate/region/TileCache.hpp"
+#include "corrugate/sampler/SmoothingPrepare.hpp"
+
+#include "BenchCommon.hpp"
+
+// region generation throughput vs thread count (height + 2 splat layers + tree fill)
+
+#define REGION_SIZE 2048
+#define BOX_COUNT 512
+#define ARCHIVE_TILE_SIZE 256
+#define ARCHIVE_PATH "region_bench.cga"
+#define SMOOTHING_CACHE_PATH "region_bench.cgsc"
+#define PYRAMID_SIZE 1024
+#define PYRAMID_LEVELS 6
+#define STREAM_SIZE 4096
+#define STREAM_BUDGET (16 * 1024 * 1024)
+#define CACHE_TILE_SIZE 256
+#define REGEN_SIZE 1024
+#define REGEN_TILE_SIZE 128
+#define TERRAIN_BOX_COUNT 16
+
+struct WaveSampler {
+  float Sample(double x, double y) const {
+    return static_cast<float>(x * 0.001 + y * 0.002);
+  }
+
+  glm::vec4 Sample(double x, double y, size_t) const {
+    return glm::vec4(static_cast<float>(x * 0.001), static_cast<float>(y * 0.001), 0.25f, 0.25f);
+  }
+};
+
+// flat height, for boxes which should visibly change the terrain under them
+struct FlatSampler {
+  float Sample(double, double) const {
+    return 4.0f;
+  }
+
+  glm::vec4 Sample(double, double, size_t) const {
+    return glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+  }
+};
+
+// writes a height tile straight from the sampler's current boxes
+size_t WriteHeightTile(const cg::MultiSampler<cg::SamplerBox>& sampler, const cg::TileKey& key, void* output, size_t n_bytes) {
+  std::unordered_set<std::shared_ptr<const cg::SamplerBox>> boxes;
+  sampler.FetchRange(key.origin, glm::dvec2(key.dims) * key.scale, boxes);
+  cg::MultiBoxSampler<cg::SamplerBox> tile_sampler(boxes);
+  return tile_sampler.WriteHeight(key.origin, key.dims, key.scale, static_cast<float*>(output), n_bytes);
+}
+
+float GetMaxDifference(const cg::TileCache::tile_type& a, const cg::TileCache::tile_type& b) {
+  const float* a_heights = reinterpret_cast<const float*>(a.data());
+  const float* b_heights = reinterpret_cast<const float*>(b.data());
+  float res = (a.size() == b.size() ? 0.0f : INFINITY);
+  for (size_t i = 0; i < std::min(a.size(), b.size()) / sizeof(float); i++) {
+    res = std::max(res, std::abs(a_heights[i] - b_heights[i]));
+  }
+
+  return res;
+}
+
+// cold pass over every tile with room for half of them, warm pass over the half that's left,
+// then an insert / remove inside one cached tile - only that tile should drop, and come back fresh
+void BenchTileCache(const std::shared_ptr<WaveSampler>& wave) {
+  cg::MultiSampler<cg::SamplerBox> sampler;
+  bench::BoxGen gen(REGION_SIZE, 64.0, 384.0);
+  for (int i = 0; i < BOX_COUNT; i++) {
+    sampler.InsertBox<cg::BaseTerrainBox>(gen.Origin(), gen.Size(), wave, wave, wave, 1.0f, 0.5f);
+  }
+
+  int tiles_per_side = REGION_SIZE / CACHE_TILE_SIZE;
+  size_t tile_count = static_cast<size_t>(tiles_per_side) * tiles_per_side;
+  size_t tile_bytes = static_cast<size_t>(CACHE_TILE_SIZE) * CACHE_TILE_SIZE * sizeof(float);
+  auto get_key = [&](size_t tile) {
+    cg::TileKey key;
+    key.origin = glm::dvec2(static_cast<double>(tile % tiles_per_side), static_cast<double>(tile / tiles_per_side)) * static_cast<double>(CACHE_TILE_SIZE);
+    key.dims = glm::ivec2(CACHE_TILE_SIZE);
+    key.layer = cg::LAYER_HEIGHT;
+    return key;
+  };
+
+  auto write = [&](size_t tile) {
+    return [&, tile](void* output, size_t n_bytes) { return WriteHeightTile(sampler, get_key(tile), output, n_bytes); };
+  };
+
+  cg::TileCache cache(tile_bytes * (tile_count / 2));
+  cache.Attach(sampler);
+
+  bench::Timer cold_timer;
+  for (size_t tile = 0; tile < tile_count; tile++) {
+    cache.GetOrWrite(get_key(tile), tile_bytes, write(tile));
+  }
+
+  double cold_time = cold_timer.Seconds();
+  cg::TileCacheStats stats = cache.GetStats();
+  bench::Check(stats.misses == tile_count && stats.hits == 0, "tile cache: cold pass misses every tile");
+  bench::Check(stats.evictions == tile_count / 2 && stats.entries == tile_count / 2, "tile cache: cold pass evicts down to budget");
+  bench::Check(stats.bytes <= cache.GetBudget(), "tile cache: bytes within budget");
+
+  // most recent half survived
+  bench::Timer warm_timer;
+  for (size_t tile = tile_count / 2; tile < tile_count; tile++) {
+    cache.GetOrWrite(get_key(tile), tile_bytes, write(tile));
+  }
+
+  double warm_time = warm_timer.Seconds();
+  stats = cache.GetStats();
+  bench::Check(stats.hits == tile_count / 2 && stats.misses == tile_count, "tile cache: warm pass hits every kept tile");
+
+  // least recently used went first
+  cache.GetOrWrite(get_key(0), tile_bytes, write(0));
+  stats = cache.GetStats();
+  bench::Check(stats.misses == tile_count + 1 && stats.evictions == tile_count / 2 + 1, "tile cache: evicted tile misses, and evicts the next oldest");
+  bench::Check(cache.Find(get_key(tile_count / 2)) == nullptr && cache.Find(get_key(tile_count - 1)) != nullptr, "tile cache: lru order");
+
+  // edit strictly inside the last tile
+  size_t edited = tile_count - 1;
+  cg::TileKey edited_key = get_key(edited);
+  auto before = cache.Find(edited_key);
+  auto flat = std::make_shared<FlatSampler>();
+  auto box = sampler.InsertBox<cg::BaseTerrainBox>(edited_key.origin + glm::dvec2(64.0), glm::dvec2(64.0), flat, flat, flat, 1.0f, 0.5f);
+  stats = cache.GetStats();
+  bench::Check(stats.invalidations == 1 && cache.Find(edited_key) == nullptr, "tile cache: insert drops the tile under the box");
+  bench::Check(cache.Find(get_key(edited - 1)) != nullptr, "tile cache: insert keeps neighbouring tiles");
+
+  auto inserted = cache.GetOrWrite(edited_key, tile_bytes, write(edited));
+  cg::TileCache::tile_type fresh(tile_bytes);
+  WriteHeightTile(sampler, edited_key, fresh.data(), tile_bytes);
+  bench::Check(inserted != nullptr && GetMaxDifference(*inserted, fresh) == 0.0f && GetMaxDifference(*inserted, *before) > 0.1f, "tile cache: rewritten tile shows the insert");
+
+  sampler.RemoveBox(box);
+  stats = cache.GetStats();
+  bench::Check(stats.invalidations == 2 && cache.Find(edited_key) == nullptr, "tile cache: remove drops the tile under the box");
+  auto removed = cache.GetOrWrite(edited_key, tile_bytes, write(edited));
+  bench::Check(removed != nullptr && GetMaxDifference(*removed, *before) < 0.0001f, "tile cache: rewritten tile matches the tile before the insert");
+
+  stats = cache.GetStats();
+  std::cout << "tile cache, tiles: " << tile_count
+            << ", budget tiles: " << (cache.GetBudget() / tile_bytes)
+            << ", cold ms: " << (cold_time * 1e3)
+            << ", warm ms: " << (warm_time * 1e3)
+            << ", hits: " << stats.hits
+            << ", misses: " << stats.misses
+            << ", evictions: " << stats.evictions
+            << ", invalidations: " << stats.invalidations << std::endl;
+
+  bench::Record("tile_cache", {
+    { "tiles", tile_count },
+    { "budget_bytes", cache.GetBudget() },
+    { "cold_ms", cold_time * 1e3 },
+    { "warm_ms", warm_time * 1e3 },
+    { "hits", stats.hits },
+    { "misses", stats.misses },
+    { "evictions", stats.evictions },
+    { "invalidations", stats.invalidations }
+  });
+
+  cache.Detach();
+}
+
+struct RegionLayers {
+  std::vector<float> height;
+  std::vector<glm::vec4> splat;
+  std::vector<float> tree_fill;
+
+  RegionLayers(size_t elems) : height(elems), splat(elems), tree_fill(elems) {}
+
+  cg::RegionBuffers GetBuffers() {
+    cg::RegionBuffers buffers;
+    buffers.height = height.data();
+    buffers.splat = splat.data();
+    buffers.splat_count = 1;
+    buffers.tree_fill = tree_fill.data();
+    return buffers;
+  }
+
+  float GetMaxDifference(const RegionLayers& other) const {
+    float res = 0.0f;
+    for (size_t i = 0; i < height.size(); i++) {
+      res = std::max(res, std::abs(height[i] - other.height[i]));
+      for (int c = 0; c < 4; c++) {
+        res = std::max(res, std::abs(splat[i][c] - other.splat[i][c]));
+      }
+
+      res = std::max(res, std::abs(tree_fill[i] - other.tree_fill[i]));
+    }
+
+    return res;
+  }
+};
+
+// moves one box, then regenerates only the journaled tiles - should match a full generate of the edited sampler
+void BenchRegenerate(const std::shared_ptr<WaveSampler>& wave) {
+  cg::MultiSampler<cg::SamplerBox> sampler;
+  bench::BoxGen gen(REGEN_SIZE, 64.0, 384.0);
+  for (int i = 0; i < BOX_COUNT / 4; i++) {
+    sampler.InsertBox<cg::BaseTerrainBox>(gen.Origin(), gen.Size(), wave, wave, wave, 1.0f, 0.5f);
+  }
+
+  auto flat = std::make_shared<FlatSampler>();
+  auto box = sampler.InsertBox<cg::BaseTerrainBox>(glm::dvec2(100.0, 150.0), glm::dvec2(96.0, 80.0), flat, flat, flat, 1.0f, 0.5f);
+
+  unsigned int threads = std::max(std::thread::hardware_concurrency(), 1U);
+  cg::ThreadPool pool(threads);
+  cg::RegionGenerator<cg::SamplerBox> generator(sampler, pool, REGEN_TILE_SIZE);
+  glm::ivec2 dims(REGEN_SIZE);
+  size_t elems = static_cast<size_t>(REGEN_SIZE) * REGEN_SIZE;
+
+  RegionLayers incremental(elems);
+  generator.Generate(glm::dvec2(0.0), dims, 1.0, incremental.GetBuffers());
+
+  cg::EditJournal journal;
+  journal.Attach(sampler);
+  sampler.RemoveBox(box);
+  sampler.InsertBox<cg::BaseTerrainBox>(glm::dvec2(700.0, 620.0), glm::dvec2(96.0, 80.0), flat, flat, flat, 1.0f, 0.5f);
+  journal.Detach();
+
+  std::vector<cg::DirtyRect> dirty = journal.Take();
+  bench::Check(dirty.size() == 2 && journal.size() == 0, "regenerate: journal records the remove and the insert, and drains");
+
+  // every tile with a sample inside (or on the edge of) a dirty rect, by brute force
+  std::vector<glm::ivec2> tiles;
+  generator.GetDirtyTiles(glm::dvec2(0.0), dims, 1.0, dirty, tiles);
+  glm::ivec2 tile_count = generator.GetTileCount(dims);
+  std::vector<glm::ivec2> expected;
+  for (int y = 0; y < tile_count.y; y++) {
+    for (int x = 0; x < tile_count.x; x++) {
+      glm::dvec2 tile_begin = glm::dvec2(x, y) * static_cast<double>(REGEN_TILE_SIZE);
+      glm::dvec2 tile_end = tile_begin + glm::dvec2(REGEN_TILE_SIZE - 1);
+      for (auto& rect : dirty) {
+        glm::dvec2 rect_end = rect.GetEnd();
+        if (tile_begin.x <= rect_end.x && tile_end.x >= rect.origin.x && tile_begin.y <= rect_end.y && tile_end.y >= rect.origin.y) {
+          expected.push_back(glm::ivec2(x, y));
+          break;
+        }
+      }
+    }
+  }
+
+  auto tile_less = [](const glm::ivec2& a, const glm::ivec2& b) { return (a.y != b.y ? a.y < b.y : a.x < b.x); };
+  std::sort(tiles.begin(), tiles.end(), tile_less);
+  bench::Check(tiles == expected, "regenerate: dirty tiles are the tiles under the old and new footprints");
+
+  RegionLayers full(elems);
+  cg::RegionStats full_stats = generator.Generate(glm::dvec2(0.0), dims, 1.0, full.GetBuffers());
+  float stale_diff = incremental.GetMaxDifference(full);
+  bench::Check(stale_diff > 0.1f, "regenerate: the move changes the region");
+
+  cg::RegionStats stats = generator.Regenerate(glm::dvec2(0.0), dims, 1.0, incremental.GetBuffers(), dirty);
+  float diff = incremental.GetMaxDifference(full);
+  bench::Check(stats.tiles == tiles.size(), "regenerate: regenerates the dirty tiles only");
+  bench::Check(diff < 0.00001f, "regenerate: matches a full generate");
+
+  std::cout << "regenerate, threads: " << threads
+            << ", tiles: " << stats.tiles << " of " << full_stats.tiles
+            << ", ms: " << (stats.seconds * 1e3)
+            << ", full ms: " << (full_stats.seconds * 1e3)
+            << ", max diff: " << diff
+            << " (before: " << stale_diff << ")" << std::endl;
+
+  bench::Record("regenerate", {
+    { "threads", threads },
+    { "size", REGEN_SIZE },
+    { "tiles", stats.tiles },
+    { "total_tiles", full_stats.tiles },
+    { "ms", stats.seconds * 1e3 },
+    { "full_ms", full_stats.seconds * 1e3 },
+    { "max_diff", diff }
+  });
+}
+
+// curved terrain, so slopes vary across a box
+struct RippleSampler {
+  float Sample(double x, double y) const {
+    return static_cast<float>(6.0 * std::sin(x * 0.011) * std::cos(y * 0.017) + 2.0 * std::sin((x + y) * 0.05));
+  }
+
+  glm::vec4 Sample(double, double, size_t) const {
+    return glm::vec4(0.25f);
+  }
+};
+
+// base terrain for smoothing estimates - a few boxes, read a point at a time
+class BoxTerrain {
+ public:
+  BoxTerrain(const std::vector<std::shared_ptr<const cg::SamplerBox>>& boxes) : sampler_(boxes) {}
+
+  float Sample(double x, double y) const {
+    return sampler_.SampleHeight(x, y);
+  }
+
+ protected:
+  cg::MultiBoxSampler<cg::SamplerBox> sampler_;
+};
+
+// same terrain with a bulk height writer - estimates read it a grid at a time
+class BulkBoxTerrain : public BoxTerrain {
+ public:
+  using BoxTerrain::BoxTerrain;
+
+  size_t WriteHeight(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) const {
+    return sampler_.WriteHeight(origin, sample_dims, scale, output, n_bytes);
+  }
+};
+
+std::vector<std::shared_ptr<const cg::SamplerBox>> MakeTerrainBoxes() {
+  auto ripple = std::make_shared<RippleSampler>();
+  bench::BoxGen gen(REGION_SIZE, 512.0, 1024.0, 99);
+  std::vector<std::shared_ptr<const cg::SamplerBox>> boxes;
+  for (int i = 0; i < TERRAIN_BOX_COUNT; i++) {
+    boxes.push_back(std::make_shared<cg::BaseTerrainBox>(gen.Origin(), gen.Size(), ripple, ripple, ripple, 1.0f, 0.5f));
+  }
+
+  return boxes;
+}
+
+// fresh smoothing boxes over the region, in insertion order (prepared estimates stick, so every run needs its own)
+void MakeSmoothingBoxes(
+  const std::shared_ptr<WaveSampler>& wave,
+  cg::MultiSampler<cg::SmoothingTerrainBox>& boxes,
+  std::vector<std::shared_ptr<const cg::SmoothingTerrainBox>>& order
+) {
+  bench::BoxGen gen(REGION_SIZE, 64.0, 384.0);
+  for (int i = 0; i < BOX_COUNT; i++) {
+    order.push_back(boxes.InsertBox(std::make_unique<cg::SmoothingTerrainBox>(gen.Origin(), gen.Size(), wave, wave, wave, 1.0f, 0.5f, 0.5f)));
+  }
+}
+
+void GetEstimates(const std::vector<std::shared_ptr<const cg::SmoothingTerrainBox>>& order, std::vector<cg::SmoothingEstimate>& output) {
+  output.resize(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i]->GetSmoothingEstimate(output[i]);
+  }
+}
+
+// height difference, or relative max slope difference - slope factor is 1 - max_slope_const / max_slope,
+// so on near flat boxes it's huge and a tiny change in slope moves it a lot
+double GetMaxDifference(const std::vector<cg::SmoothingEstimate>& a, const std::vector<cg::SmoothingEstimate>& b) {
+  double res = (a.size() == b.size() ? 0.0 : INFINITY);
+  for (size_t i = 0; i < std::min(a.size(), b.size()); i++) {
+    double slope_a = 1.0 - a[i].slope_factor;
+    double slope_b = 1.0 - b[i].slope_factor;
+    res = std::max(res, std::abs(a[i].height_origin - b[i].height_origin));
+    res = std::max(res, std::abs(slope_a - slope_b) / std::max(std::max(std::abs(slope_a), std::abs(slope_b)), 1e-9));
+  }
+
+  return res;
+}
+
+template <typename BaseType>
+double TimePrepare(const std::shared_ptr<WaveSampler>& wave, const std::shared_ptr<BaseType>& base, cg::ThreadPool& pool, std::vector<cg::SmoothingEstimate>& estimates) {
+  cg::MultiSampler<cg::SmoothingTerrainBox> boxes;
+  std::vector<std::shared_ptr<const cg::SmoothingTerrainBox>> order;
+  MakeSmoothingBoxes(wave, boxes, order);
+
+  bench::Timer timer;
+  cg::PrepareAll(boxes, base, pool);
+  double time = timer.Seconds();
+
+  GetEstimates(order, estimates);
+  return time;
+}
+
+// smoothing cache preparation for every box vs thread count, reading the base terrain point by point (Sample)
+// and a grid at a time (WriteHeight) - both should land on the same estimates
+void BenchPrepare(const std::shared_ptr<WaveSampler>& wave) {
+  auto terrain_boxes = MakeTerrainBoxes();
+  auto terrain = std::make_shared<BoxTerrain>(terrain_boxes);
+  auto bulk_terrain = std::make_shared<BulkBoxTerrain>(terrain_boxes);
+  static_assert(!cg::trait::height_chunk_trait<BoxTerrain>::value && cg::trait::height_chunk_trait<BulkBoxTerrain>::value);
+
+  unsigned int max_threads = std::max(std::thread::hardware_concurrency(), 1U);
+  double base_time = 0.0;
+  for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+    cg::ThreadPool pool(threads);
+    std::vector<cg::SmoothingEstimate> estimates;
+    std::vector<cg::SmoothingEstimate> bulk_estimates;
+    double time = TimePrepare(wave, terrain, pool, estimates);
+    double bulk_time = TimePrepare(wave, bulk_terrain, pool, bulk_estimates);
+
+    if (threads == 1) {
+      base_time = time;
+    }
+
+    double diff = GetMaxDifference(estimates, bulk_estimates);
+    bench::Check(diff < 0.001, "prepare smoothing: Sample and WriteHeight estimates agree");
+
+    std::cout << "prepare smoothing, threads: " << threads
+              << ", boxes: " << BOX_COUNT
+              << ", ms: " << (time * 1e3)
+              << ", speedup: " << (base_time / time)
+              << ", WriteHeight ms: " << (bulk_time * 1e3)
+              << ", vs Sample: " << (time / bulk_time)
+              << ", max diff: " << diff << std::endl;
+
+    bench::Record("prepare_smoothing", {
+      { "threads", threads },
+      { "boxes", BOX_COUNT },
+      { "ms", time * 1e3 },
+      { "write_height_ms", bulk_time * 1e3 },
+      { "max_diff", diff }
+    });
+  }
+}
+
+// cold prepare + save, then load + warm prepare on fresh boxes - the warm run shouldn't compute anything
+void BenchSmoothingCache(const std::shared_ptr<WaveSampler>& wave) {
+  auto terrain = std::make_shared<BulkBoxTerrain>(MakeTerrainBoxes());
+  uint64_t fingerprint = cg::SmoothingCache::FingerprintSampler(terrain);
+  cg::ThreadPool pool(1);
+
+  cg::MultiSampler<cg::SmoothingTerrainBox> cold_boxes;
+  std::vector<std::shared_ptr<const cg::SmoothingTerrainBox>> cold_order;
+  MakeSmoothingBoxes(wave, cold_boxes, cold_order);
+
+  cg::SmoothingCache cold_cache(fingerprint);
+  bench::Timer cold_timer;
+  size_t computed = cg::PrepareAll(cold_boxes, terrain, pool, cold_cache);
+  bool saved = cold_cache.Save(SMOOTHING_CACHE_PATH);
+  double cold_time = cold_timer.Seconds();
+  bench::Check(computed == BOX_COUNT && cold_cache.size() == BOX_COUNT && saved, "smoothing cache: cold run computes and saves every box");
+
+  cg::MultiSampler<cg::SmoothingTerrainBox> warm_boxes;
+  std::vector<std::shared_ptr<const cg::SmoothingTerrainBox>> warm_order;
+  MakeSmoothingBoxes(wave, warm_boxes, warm_order);
+
+  cg::SmoothingCache warm_cache(fingerprint);
+  bench::Timer warm_timer;
+  bool loaded = warm_cache.Load(SMOOTHING_CACHE_PATH);
+  size_t warm_computed = cg::PrepareAll(warm_boxes, terrain, pool, warm_cache);
+  double warm_time = warm_timer.Seconds();
+  bench::Check(loaded && warm_computed == 0, "smoothing cache: warm run computes nothing");
+
+  std::vector<cg::SmoothingEstimate> cold_estimates;
+  std::vector<cg::SmoothingEstimate> warm_estimates;
+  GetEstimates(cold_order, cold_estimates);
+  GetEstimates(warm_order, warm_estimates);
+  bench::Check(GetMaxDifference(cold_estimates, warm_estimates) == 0.0, "smoothing cache: warm estimates match cold ones");
+
+  cg::SmoothingCache other_cache(fingerprint + 1);
+  bench::Check(!other_cache.Load(SMOOTHING_CACHE_PATH) && other_cache.size() == 0, "smoothing cache: another fingerprint's file is rejected");
+
+  // savers racing on one path - each save goes through its own temp file, so every load sees a whole file
+  std::atomic<int> failures(0);
+  std::vector<std::thread> savers;
+  for (int i = 0; i < 4; i++) {
+    savers.emplace_back([&]() {
+      cg::SmoothingCache writer(fingerprint);
+      writer.Collect(cold_boxes);
+      for (int j = 0; j < 16; j++) {
+        cg::SmoothingCache reader(fingerprint);
+        if (!writer.Save(SMOOTHING_CACHE_PATH) || !reader.Load(SMOOTHING_CACHE_PATH) || reader.size() != BOX_COUNT) {
+          failures++;
+        }
+      }
+    });
+  }
+
+  for (auto& saver : savers) {
+    saver.join();
+  }
+
+  bench::Check(failures == 0, "smoothing cache: concurrent saves always leave a whole file");
+
+  // drop the last few bytes
+  std::vector<char> bytes;
+  if (FILE* file = std::fopen(SMOOTHING_CACHE_PATH, "rb")) {
+    char buffer[4096];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      bytes.insert(bytes.end(), buffer, buffer + count);
+    }
+
+    std::fclose(file);
+  }
+
+  if (FILE* file = std::fopen(SMOOTHING_CACHE_PATH, "wb")) {
+    std::fwrite(bytes.data(), 1, bytes.size() - std::min(bytes.size(), static_cast<size_t>(5)), file);
+    std::fclose(file);
+  }
+
+  cg::SmoothingCache truncated_cache(fingerprint);
+  bench::Check(!truncated_cache.Load(SMOOTHING_CACHE_PATH) && truncated_cache.size() == 0, "smoothing cache: truncated file is rejected");
+  std::remove(SMOOTHING_CACHE_PATH);
+
+  std::cout << "smoothing cache, boxes: " << BOX_COUNT
+            << ", file bytes: " << bytes.size()
+            << ", cold ms: " << (cold_time * 1e3)
+            << ", warm ms: " << (warm_time * 1e3)
+            << ", speedup: " << (cold_time / warm_time) << std::endl;
+
+  bench::Record("smoothing_cache", {
+    { "boxes", BOX_COUNT },
+    { "bytes", bytes.size() },
+    { "cold_ms", cold_time * 1e3 },
+    { "warm_ms", warm_time * 1e3 }
+  });
+}
+
+// bake the region into a tile archive, then time opening it and touching every tile
+void BenchArchive(const std::vector<std::shared_ptr<const cg::SamplerBox>>& boxes) {
+  cg::MultiBoxSampler<cg::SamplerBox> sampler(boxes);
+  cg::QuantizedChunkLayers request;
+  request.mask = cg::LAYER_ALL;
+  request.height_min = -8.0f;
+  request.height_max = 8.0f;
+  request.splat_count = 2;
+
+  glm::ivec2 tile_count(REGION_SIZE / ARCHIVE_TILE_SIZE);
+  cg::TileArchiveWriter writer;
+  bench::Timer bake_timer;
+  if (!writer.Open(ARCHIVE_PATH, glm::dvec2(0.0), ARCHIVE_TILE_SIZE, 1.0)
+    || cg::BakeTiles(writer, sampler, glm::dvec2(0.0), tile_count, ARCHIVE_TILE_SIZE, 1.0, 0, request) == 0
+    || !writer.Finish()) {
+    std::cout << "archive bake failed" << std::endl;
+    return;
+  }
+
+  double bake_time = bake_timer.Seconds();
+
+  bench::Timer open_timer;
+  cg::TileArchive archive;
+  if (!archive.Open(ARCHIVE_PATH)) {
+    std::cout << "archive open failed" << std::endl;
+    return;
+  }
+
+  double open_time = open_timer.Seconds();
+
+  // one byte per page is enough to fault every tile in
+  bench::Timer read_timer;
+  uint64_t sum = 0;
+  size_t bytes = 0;
+  for (const cg::TileArchiveEntry& entry : archive) {
+    const uint8_t* data = static_cast<const uint8_t*>(archive.GetData(entry));
+    for (size_t i = 0; i < entry.bytes; i += 4096) {
+      sum += data[i];
+    }
+
+    bytes += entry.bytes;
+  }
+
+  double read_time = read_timer.Seconds();
+
+  std::cout << "archive, tiles: " << archive.GetTileCount()
+            << ", MB: " << (bytes / 1e6)
+            << ", bake ms: " << (bake_time * 1e3)
+            << ", open ms: " << (open_time * 1e3)
+            << ", first touch ms: " << (read_time * 1e3)
+            << " (" << (sum & 1) << ")" << std::endl;
+
+  bench::Record("archive", {
+    { "tiles", archive.GetTileCount() },
+    { "bytes", bytes },
+    { "bake_ms", bake_time * 1e3 },
+    { "open_ms", open_time * 1e3 },
+    { "first_touch_ms", read_time * 1e3 }
+  });
+
+  archive.Close();
+
+  // bakers racing on one path - each writes its own temp file, and whichever renames last leaves a whole archive
+  std::atomic<size_t> baked[2] = { { 0 }, { 0 } };
+  std::vector<std::thread> bakers;
+  for (int i = 0; i < 2; i++) {
+    bakers.emplace_back([&, i]() {
+      cg::TileArchiveWriter racer;
+      if (racer.Open(ARCHIVE_PATH, glm::dvec2(0.0), ARCHIVE_TILE_SIZE, 1.0)) {
+        size_t tiles = cg::BakeTiles(racer, sampler, glm::dvec2(0.0), glm::ivec2(2), ARCHIVE_TILE_SIZE, 1.0, 0, request);
+        baked[i] = (racer.Finish() ? tiles : 0);
+      }
+    });
+  }
+
+  for (auto& baker : bakers) {
+    baker.join();
+  }
+
+  cg::TileArchive raced;
+  bench::Check(baked[0] > 0 && baked[0] == baked[1] && raced.Open(ARCHIVE_PATH) && raced.GetTileCount() == baked[0], "archive: concurrent bakes leave a whole archive");
+  raced.Close();
+  std::remove(ARCHIVE_PATH);
+}
+
+// lod levels: re-sampling every level at its own scale vs writing level 0 once and reducing it
+void BenchPyramid(const std::vector<std::shared_ptr<const cg::SamplerBox>>& boxes) {
+  cg::MultiBoxSampler<cg::SamplerBox> sampler(boxes);
+  cg::ChunkLayers request;
+  request.mask = cg::LAYER_ALL;
+  request.splat_count = 2;
+
+  bench::Timer resample_timer;
+  double scale = 1.0;
+  for (int level = 0, size = PYRAMID_SIZE; level < PYRAMID_LEVELS; level++, size = (size + 1) / 2, scale *= 2.0) {
+    size_t elems = static_cast<size_t>(size) * size;
+    std::vector<float> height(elems);
+    std::vector<glm::vec4> splat(elems * 2);
+    std::vector<float> tree_fill(elems);
+
+    cg::ChunkLayers layers = request;
+    layers.height = height.data();
+    layers.splat = splat.data();
+    layers.tree_fill = tree_fill.data();
+    sampler.WriteLayers(glm::dvec2(0.0), glm::ivec2(size), scale, layers);
+  }
+
+  double resample_time = resample_timer.Seconds();
+
+  const cg::MipFilter filters[2] = { cg::MIP_FILTER_BOX, cg::MIP_FILTER_BINOMIAL };
+  const char* names[2] = { "box", "binomial" };
+  for (int i = 0; i < 2; i++) {
+    cg::MipOptions options;
+    options.filter = filters[i];
+
+    cg::MipPyramid pyramid;
+    bench::Timer build_timer;
+    pyramid.Build(sampler, glm::dvec2(0.0), glm::ivec2(PYRAMID_SIZE), 1.0, request, PYRAMID_LEVELS, options);
+    double build_time = build_timer.Seconds();
+
+    std::cout << "pyramid " << names[i]
+              << ", levels: " << pyramid.GetLevelCount()
+              << ", re-sample ms: " << (resample_time * 1e3)
+              << ", reduce ms: " << (build_time * 1e3)
+              << ", speedup: " << (resample_time / build_time) << std::endl;
+
+    bench::Record("pyramid", {
+      { "filter", names[i] },
+      { "size", PYRAMID_SIZE },
+      { "levels", pyramid.GetLevelCount() },
+      { "resample_ms", resample_time * 1e3 },
+      { "reduce_ms", build_time * 1e3 }
+    });
+  }
+}
+
+// streams the same area at 4x the samples through a small budget - peak rss should stay near the budget
+void BenchStream(const cg::MultiSampler<cg::SamplerBox>& sampler) {
+  cg::ChunkLayers request;
+  request.mask = cg::LAYER_ALL;
+  request.splat_count = 2;
+
+  cg::RegionStreamOptions options;
+  options.memory_budget = STREAM_BUDGET;
+
+  unsigned int threads = std::max(std::thread::hardware_concurrency(), 1U);
+  cg::ThreadPool pool(threads);
+  cg::RegionStream stream(cg::RegionStream::GetWriter(sampler, pool), pool, glm::dvec2(0.0), glm::ivec2(STREAM_SIZE), 0.5, request, options);
+
+  // consumer just sums the heights, like a writer draining to disk would touch them
+  cg::RegionBlock block;
+  double sum = 0.0;
+  while (stream.Next(block)) {
+    size_t elems = static_cast<size_t>(block.dims.x) * block.dims.y;
+    for (size_t i = 0; i < elems; i++) {
+      sum += block.layers.height[i];
+    }
+  }
+
+  cg::RegionStats stats = stream.GetStats();
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  size_t region_bytes = request.GetByteCount(glm::ivec2(STREAM_SIZE));
+  std::cout << "stream, threads: " << threads
+            << ", blocks: " << stats.tiles
+            << ", blocks/sec: " << stats.GetTilesPerSecond()
+            << ", slots: " << stream.GetSlotCount()
+            << ", block MB: " << (stream.GetMemoryUsage() / 1e6)
+            << ", region MB: " << (region_bytes / 1e6)
+            << ", peak rss MB: " << (usage.ru_maxrss / 1e3)
+            << " (" << (sum != 0.0) << ")" << std::endl;
+
+  bench::Record("stream", {
+    { "threads", threads },
+    { "size", STREAM_SIZE },
+    { "blocks", stats.tiles },
+    { "blocks_per_sec", stats.GetTilesPerSecond() },
+    { "block_bytes", stream.GetMemoryUsage() },
+    { "region_bytes", region_bytes },
+    { "peak_rss_kb", usage.ru_maxrss }
+  });
+}
+
+int main(int argc, char** argv) {
+  bench::Init(argc, argv, "RegionBench");
+
+  auto wave = std::make_shared<WaveSampler>();
+  BenchPrepare(wave);
+  BenchSmoothingCache(wave);
+
+  cg::MultiSampler<cg::SamplerBox> sampler;
+  bench::BoxGen gen(REGION_SIZE, 64.0, 384.0);
+  for (int i = 0; i < BOX_COUNT; i++) {
+    sampler.InsertBox<cg::BaseTerrainBox>(gen.Origin(), gen.Size(), wave, wave, wave, 1.0f, 0.5f);
+  }
+
+  // before the region buffers below, so peak rss is the stream's own
+  BenchStream(sampler);
+
+  size_t elems = static_cast<size_t>(REGION_SIZE) * REGION_SIZE;
+  std::vector<float> height(elems);
+  std::vector<glm::vec4> splat(elems * 2);
+  std::vector<float> tree_fill(elems);
+
+  cg::RegionBuffers buffers;
+  buffers.height = height.data();
+  buffers.splat = splat.data();
+  buffers.splat_count = 2;
+  buffers.tree_fill = tree_fill.data();
+
+  unsigned int max_threads = std::max(std::thread::hardware_concurrency(), 1U);
+  double base_rate = 0.0;
+  for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+    cg::ThreadPool pool(threads);
+    cg::RegionGenerator<cg::SamplerBox> generator(sampler, pool);
+
+    // warm up workspaces
+    generator.Generate(glm::dvec2(0.0), glm::ivec2(REGION_SIZE), 1.0, buffers);
+    cg::RegionStats stats = generator.Generate(glm::dvec2(0.0), glm::ivec2(REGION_SIZE), 1.0, buffers);
+
+    if (threads == 1) {
+      base_rate = stats.GetTilesPerSecond();
+    }
+
+    std::cout << "threads: " << threads
+              << ", tiles: " << stats.tiles
+              << ", tiles/sec: " << stats.GetTilesPerSecond()
+              << ", speedup: " << (stats.GetTilesPerSecond() / base_rate) << std::endl;
+
+    bench::Record("generate", {
+      { "threads", threads },
+      { "size", REGION_SIZE },
+      { "tiles", stats.tiles },
+      { "tiles_per_sec", stats.GetTilesPerSecond() }
+    });
+  }
+
+  std::unordered_set<std::shared_ptr<const cg::SamplerBox>> boxes;
+  sampler.FetchRange(glm::dvec2(0.0), glm::dvec2(REGION_SIZE), boxes);
+  std::vector<std::shared_ptr<const cg::SamplerBox>> box_list(boxes.begin(), boxes.end());
+  BenchPyramid(box_list);
+  BenchArchive(box_list);
+  BenchTileCache(wave);
+  BenchRegenerate(wave);
+  return bench::Finish();
+}
@@ -13,6 +13,8 @@
 // - that being said: we should support roughly the same interface for fairway, green, sand, etc...
 // - we should associate SDFs with boxes (i think sdfs for green, rough, etc etc...)
 
+#include "corrugate/simd/FalloffKernel.hpp"
+
 #include <glm/glm.hpp>
 
 namespace cg {
@@ -45,6 +47,45 @@ namespace cg {
       return GetFalloffWeight_local(local);
     }
 
+    /**
+     * @brief Writes falloff weights for a row of samples
+     *
+     * @param start - global coords of the first sample
+     * @param step - x distance between samples
+     * @param count - number of samples
+     * @param output - weight output (count floats)
+     */
+    void WriteFalloffRow(const glm::dvec2& start, double step, int count, float* output) const {
+      simd::WriteFalloffRow<false>(GetFalloffRow_local(start - GetOrigin(), step), count, output);
+    }
+
+    // same as above, but adds weights to output
+    void AccumulateFalloffRow(const glm::dvec2& start, double step, int count, float* output) const {
+      simd::WriteFalloffRow<true>(GetFalloffRow_local(start - GetOrigin(), step), count, output);
+    }
+
+    /**
+     * @brief Adds this box's falloff weights to a chunk of samples.
+     *        Only touches samples inside the box footprint.
+     *
+     * @param origin - global origin of the chunk
+     * @param sample_dims - num of x/y samples
+     * @param scale - distance between samples
+     * @param output - falloff sum (sample_dims.x * sample_dims.y floats)
+     */
+    void AccumulateFalloff(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output) const {
+      glm::dvec2 origin_local = origin - GetOrigin();
+      glm::ivec2 begin, end;
+      if (!GetFootprintSamples_local(origin_local, sample_dims, scale, begin, end)) {
+        return;
+      }
+
+      for (int y = begin.y; y < end.y; y++) {
+        glm::dvec2 row_start = origin_local + glm::dvec2(begin.x, y) * scale;
+        simd::WriteFalloffRow<true>(GetFalloffRow_local(row_start, scale), end.x - begin.x, output + static_cast<size_t>(y) * sample_dims.x + begin.x);
+      }
+    }
+
     const glm::dvec2 origin;
     const glm::dvec2 size;
 
@@ -73,6 +114,44 @@ namespace cg {
       falloff_val = glm::smoothstep(0.0f, 1.0f, falloff_val);
       return 1.0f - falloff_val;
     }
+
+    // row form of GetFalloffWeight_local, for the simd kernel
+    simd::FalloffRow GetFalloffRow_local(const glm::dvec2& start_local, double step) const {
+      glm::dvec2 half_size = glm::max(GetSize() * 0.5, glm::dvec2(0.001));
+
+      simd::FalloffRow row;
+      row.offset = static_cast<float>((start_local.x - half_size.x) / half_size.x);
+      row.step = static_cast<float>(step / half_size.x);
+      row.dist_y = static_cast<float>(glm::abs((start_local.y - half_size.y) / half_size.y));
+      row.falloff_start = glm::min(falloff_radius * (1.0f - falloff_size), 0.99999f);
+      row.inv_falloff_range = 1.0f / (1.0f - row.falloff_start);
+      return row;
+    }
+
+    /**
+     * @brief Finds the samples of a chunk which can have nonzero falloff weight.
+     *        Conservative by a sample on each side - extra samples just weigh 0.
+     *
+     * @param origin_local - chunk origin, relative to box origin
+     * @param sample_dims - num of x/y samples in chunk
+     * @param scale - distance between samples
+     * @param begin - output, first sample (inclusive)
+     * @param end - output, last sample (exclusive)
+     * @return true if any sample overlaps the footprint
+     */
+    bool GetFootprintSamples_local(const glm::dvec2& origin_local, const glm::ivec2& sample_dims, double scale, glm::ivec2& begin, glm::ivec2& end) const {
+      glm::dvec2 footprint = glm::max(GetSize() * 0.5, glm::dvec2(0.001)) * 2.0;
+      glm::dvec2 first = glm::floor(-origin_local / scale);
+      glm::dvec2 last = glm::ceil((footprint - origin_local) / scale) + 1.0;
+
+      // clamp in double - far off boxes would overflow the int conversion
+      first = glm::clamp(first, glm::dvec2(0.0), glm::dvec2(sample_dims));
+      last = glm::clamp(last, glm::dvec2(0.0), glm::dvec2(sample_dims));
+
+      begin = glm::ivec2(first);
+      end = glm::ivec2(last);
+      return (begin.x < end.x && begin.y < end.y);
+    }
    private:
   };
 
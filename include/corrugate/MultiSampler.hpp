@@ -2,16 +2,23 @@
 #define MULTI_SAMPLER_H_
 
 #include "corrugate/FeatureBox.hpp"
+#include "corrugate/index/GridIndex.hpp"
+#include "corrugate/index/QuadTreeIndex.hpp"
 
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <glm/glm.hpp>
-#include <glm/gtx/hash.hpp>
 
 #define _SAMPLER_CHUNK_SIZE 512
 
@@ -25,12 +32,19 @@
 // - else, increment set
 
 namespace cg {
+  // spatial index backing a MultiSampler
+  enum class IndexMode {
+    // fixed _SAMPLER_CHUNK_SIZE cells - boxes are stored in every cell they touch
+    GRID,
+    // loose quadtree - boxes are stored once, at a depth matching their size
+    QUADTREE
+  };
+
   // base sampler - identifies box positions
   template <typename BoxType>
   class MultiSampler {
     typedef std::shared_ptr<BoxType> box_type;
     typedef std::unordered_set<box_type> set_type;
-    typedef std::unordered_map<glm::ivec2, set_type> cache_type;
    public:
     typedef std::unordered_set<std::shared_ptr<const BoxType>> output_type;
     // (making these public for impl)
@@ -41,6 +55,139 @@ namespace cg {
 
     typedef typename set_type::const_iterator       iterator;
 
+    // called with the world rect (origin, size) of a box which was just inserted or removed
+    typedef std::function<void(const glm::dvec2&, const glm::dvec2&)> edit_listener;
+
+    /**
+     * @brief Immutable view of the chunk index.
+     *        InsertBox/RemoveBox never modify a published snapshot - they copy the index
+     *        (shallow: the grid's page table, or the quadtree's root), copy only the pages / cells / nodes
+     *        they touch, and publish the result as a new version (see BeginEdit to publish many edits at once).
+     *        Readers pin a snapshot and can query it for as long as they like.
+     */
+    class Snapshot {
+     public:
+      Snapshot(IndexMode mode) : mode(mode), grid(static_cast<double>(_SAMPLER_CHUNK_SIZE)) {}
+
+      void FetchPoint(const glm::dvec2& point, output_type& output) const {
+        FetchRange(point - glm::dvec2(0.5), glm::dvec2(1), output);
+      }
+
+      void FetchRange(const glm::dvec2& origin, const glm::dvec2& size, output_type& output) const {
+        ForEach(origin, size, [&](uint32_t, const std::shared_ptr<BoxType>& box) {
+          output.insert(std::const_pointer_cast<const BoxType>(box));
+        });
+      }
+
+      /**
+       * @brief Calls callback(id, box) once for each box overlapping the range.
+       *        ids are dense and stable for the lifetime of a box (they're reused after removal).
+       */
+      template <typename Callback>
+      void ForEach(const glm::dvec2& origin, const glm::dvec2& size, Callback&& callback) const {
+        if (mode == IndexMode::QUADTREE) {
+          tree.Query(origin, origin + size, callback);
+        } else {
+          grid.Query(origin, origin + size, callback);
+        }
+      }
+
+      uint64_t GetVersion() const { return version; }
+      size_t size() const { return box_count; }
+
+      // upper bound on box ids in this snapshot
+      uint32_t GetIdCapacity() const { return id_capacity; }
+
+      IndexMode GetIndexMode() const { return mode; }
+
+      size_t GetMemoryUsage() const {
+        return sizeof(Snapshot) + (mode == IndexMode::QUADTREE ? tree.GetMemoryUsage() : grid.GetMemoryUsage());
+      }
+
+     private:
+      friend class MultiSampler;
+
+      uint64_t version = 0;
+      size_t box_count = 0;
+      uint32_t id_capacity = 0;
+
+      // only the one matching mode is populated
+      IndexMode mode;
+      index::GridIndex<BoxType> grid;
+      index::QuadTreeIndex<BoxType> tree;
+    };
+
+    /**
+     * @brief Results for a batch of range queries, stored CSR-style:
+     *        hits for query i live in [offsets[i], offsets[i + 1]) of boxes/ids.
+     *
+     *        Raw pointers stay valid because the batch pins the snapshot it was fetched from.
+     *        Reuse one batch across calls - once its buffers have grown, fetching allocates nothing.
+     */
+    class FetchBatch {
+     public:
+      struct Span {
+        const BoxType* const* data;
+        const uint32_t* ids;
+        size_t count;
+
+        const BoxType* const* begin() const { return data; }
+        const BoxType* const* end() const { return data + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const BoxType* operator[](size_t i) const { return data[i]; }
+      };
+
+      // number of queries in the batch
+      size_t size() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+      }
+
+      Span Get(size_t query) const {
+        size_t start = offsets[query];
+        return Span { boxes.data() + start, ids.data() + start, offsets[query + 1] - start };
+      }
+
+      // every distinct box hit by any query in the batch, in first-hit order
+      Span GetUnique() const {
+        return Span { unique_boxes.data(), unique_ids.data(), unique_boxes.size() };
+      }
+
+      const std::shared_ptr<const Snapshot>& GetSnapshot() const {
+        return snapshot;
+      }
+
+      // drops the pinned snapshot (keeps buffers)
+      void Release() {
+        snapshot.reset();
+      }
+
+     private:
+      friend class MultiSampler;
+
+      std::shared_ptr<const Snapshot> snapshot;
+
+      std::vector<size_t> offsets;
+      std::vector<const BoxType*> boxes;
+      std::vector<uint32_t> ids;
+
+      std::vector<const BoxType*> unique_boxes;
+      std::vector<uint32_t> unique_ids;
+
+      // dedupe by id - stamps[id] == epoch means "already seen this batch"
+      std::vector<uint32_t> stamps;
+      uint32_t epoch = 0;
+    };
+
+    MultiSampler(IndexMode mode = IndexMode::GRID) : published_(new std::shared_ptr<const Snapshot>(std::make_shared<const Snapshot>(mode))) {}
+
+    ~MultiSampler() {
+      delete published_.load();
+    }
+
+    MultiSampler(const MultiSampler&) = delete;
+    MultiSampler& operator=(const MultiSampler&) = delete;
+
     iterator begin() const {
       return box_store.cbegin();
     }
@@ -49,6 +196,28 @@ namespace cg {
       return box_store.cend();
     }
 
+    /**
+     * @brief Fetches the most recently published snapshot. Never blocks on writers, and takes no lock
+     *        (std::atomic_load on a shared_ptr isn't lock-free in libstdc++ - it goes through a pooled mutex).
+     *        The returned snapshot stays valid (and unchanged) for as long as it is held.
+     *
+     *        Readers only announce themselves on a counter while they copy the pointer out -
+     *        the writer waits for those to drain before it frees the holder it swapped out (see Publish).
+     *        Copying still bumps the snapshot's refcount, so hot loops should pin one snapshot
+     *        (GetSnapshot once, then query it) rather than call FetchRange over and over.
+     */
+    std::shared_ptr<const Snapshot> GetSnapshot() const {
+      uint32_t parity = parity_.load() & 1;
+      readers_[parity].fetch_add(1);
+      std::shared_ptr<const Snapshot> res = *published_.load();
+      readers_[parity].fetch_sub(1, std::memory_order_release);
+      return res;
+    }
+
+    uint64_t GetVersion() const {
+      return GetSnapshot()->GetVersion();
+    }
+
     void FetchPoint(const glm::dvec2& point, std::unordered_set<std::shared_ptr<const BoxType>>& output) const {
       // narrow bounds here instead??
       FetchRange(point - glm::dvec2(0.5), glm::dvec2(1), output);
@@ -56,37 +225,61 @@ namespace cg {
 
     // fetch all boxes within a certain range
     void FetchRange(const glm::dvec2& origin, const glm::dvec2& size, std::unordered_set<std::shared_ptr<const BoxType>>& output) const {
-      glm::dvec2 end = origin + size;
+      // no lock - we just read whatever version was last published
+      GetSnapshot()->FetchRange(origin, size, output);
+    }
 
-      // add an epsilon i think?
-      // idea1: "pre-prep" the cache by collecting all boxes in some broad range (wrap)
-      // idea2: idk!
+    /**
+     * @brief Runs a batch of range queries against the current snapshot.
+     *
+     * @param origins - query origins
+     * @param sizes - query sizes
+     * @param count - number of queries
+     * @param output - batch to fill (cleared first)
+     */
+    void FetchRanges(const glm::dvec2* origins, const glm::dvec2* sizes, size_t count, FetchBatch& output) const {
+      FetchRanges(GetSnapshot(), origins, sizes, count, output);
+    }
 
-      glm::ivec2 chunk_floor = static_cast<glm::ivec2>(glm::floor((origin - DVEC_EPSILON) / static_cast<double>(_SAMPLER_CHUNK_SIZE)));
-      glm::ivec2 chunk_ceil = static_cast<glm::ivec2>(glm::ceil((end + DVEC_EPSILON) / static_cast<double>(_SAMPLER_CHUNK_SIZE)));
+    static void FetchRanges(
+      const std::shared_ptr<const Snapshot>& snapshot,
+      const glm::dvec2* origins,
+      const glm::dvec2* sizes,
+      size_t count,
+      FetchBatch& output
+    ) {
+      output.snapshot = snapshot;
+      output.offsets.clear();
+      output.boxes.clear();
+      output.ids.clear();
+      output.unique_boxes.clear();
+      output.unique_ids.clear();
+
+      if (output.stamps.size() < snapshot->GetIdCapacity()) {
+        output.stamps.resize(snapshot->GetIdCapacity(), 0);
+      }
 
-      // possible lock contention here??
-      std::lock_guard<std::recursive_mutex> lock(sampler_lock);
+      if (++output.epoch == 0) {
+        // wrapped - old stamps could collide
+        std::fill(output.stamps.begin(), output.stamps.end(), 0);
+        output.epoch = 1;
+      }
 
-      glm::dvec2 box_origin, box_end;
-      for (int x = chunk_floor.x; x < chunk_ceil.x; x++) {
-        for (int y = chunk_floor.y; y < chunk_ceil.y; y++) {
-          glm::ivec2 chunk(x, y);
-          typename cache_type::const_iterator itr = chunk_lookup_cache.find(chunk);
-          if (itr != chunk_lookup_cache.end()) {
-            for (auto& box : itr->second) {
-              box_origin = box->GetOrigin();
-              box_end = box->GetEnd();
-
-              if (
-                   box_origin.x < end.x     && box_origin.y < end.y
-                && box_end.x    > origin.x  && box_end.y    > origin.y
-              ) {
-                output.insert(std::const_pointer_cast<const BoxType>(box));
-              }
-            }
+      output.offsets.push_back(0);
+      for (size_t i = 0; i < count; i++) {
+        // each box is reported once per query by the index, so only the union needs deduping
+        snapshot->ForEach(origins[i], sizes[i], [&](uint32_t id, const std::shared_ptr<BoxType>& box) {
+          output.boxes.push_back(box.get());
+          output.ids.push_back(id);
+
+          if (output.stamps[id] != output.epoch) {
+            output.stamps[id] = output.epoch;
+            output.unique_boxes.push_back(box.get());
+            output.unique_ids.push_back(id);
           }
-        }
+        });
+
+        output.offsets.push_back(output.boxes.size());
       }
     }
 
@@ -96,7 +289,7 @@ namespace cg {
     }
 
     size_t size() const {
-      return box_store.size();
+      return GetSnapshot()->size();
     }
 
     // the issue is, effectively, that this container doesn't maintain its own state (it cant!)
@@ -117,6 +310,8 @@ namespace cg {
     }
 
     std::shared_ptr<BoxType> RemoveBox(const std::shared_ptr<const BoxType>& box) {
+      std::lock_guard<std::recursive_mutex> lock(sampler_lock);
+
       auto itr = box_store.find(std::const_pointer_cast<BoxType>(box));
       if (itr == box_store.end()) {
         return std::shared_ptr<BoxType>();
@@ -124,73 +319,205 @@ namespace cg {
 
       std::shared_ptr<BoxType> res = *itr;
 
+      auto id_itr = box_ids.find(res.get());
+      uint32_t id = id_itr->second;
 
-      glm::dvec2 origin = res->GetOrigin();
-      glm::dvec2 end = origin + res->GetSize();
+      std::shared_ptr<Snapshot> next = BeginChange();
+      if (next->mode == IndexMode::QUADTREE) {
+        next->tree.Remove(id, res);
+      } else {
+        next->grid.Remove(id, res);
+      }
 
-      glm::ivec2 chunk_floor = static_cast<glm::ivec2>(glm::floor((origin - DVEC_EPSILON) / static_cast<double>(_SAMPLER_CHUNK_SIZE)));
-      glm::ivec2 chunk_ceil = static_cast<glm::ivec2>(glm::ceil((end + DVEC_EPSILON) / static_cast<double>(_SAMPLER_CHUNK_SIZE)));
+      box_ids.erase(id_itr);
+      free_ids.push_back(id);
+      box_store.erase(res);
+      next->box_count = box_store.size();
+      EndChange(next, *res);
 
+      return res;
+    }
 
-      std::lock_guard<std::recursive_mutex> lock(sampler_lock);
-      for (int x = chunk_floor.x; x < chunk_ceil.x; x++) {
-        for (int y = chunk_floor.y; y < chunk_ceil.y; y++) {
-          glm::ivec2 chunk(x, y);
-          typename cache_type::iterator itr = chunk_lookup_cache.find(chunk);
-          if (itr != chunk_lookup_cache.end()) {
-
-            typename set_type::iterator itr_local = itr->second.find(res);
-            if (itr_local != itr->second.end()) {
-              itr->second.erase(itr_local);
-            }
+    /**
+     * @brief Starts a batch of edits: inserts / removes until the matching EndEdit go into one new snapshot,
+     *        published by EndEdit. Readers see all of the batch or none of it, each grid page / cell is copied
+     *        once per batch instead of once per edit, and edit listeners run once the batch is published.
+     *        Use for bulk loads - a lone edit still copies the whole page table.
+     *
+     *        Holds the writer lock until EndEdit (other writers wait). Batches nest.
+     *        Snapshots fetched mid-batch (even on this thread) don't include the batch yet.
+     */
+    void BeginEdit() {
+      sampler_lock.lock();
+      if (edit_depth++ == 0) {
+        pending = CopySnapshot();
+        pending->grid.BeginBatch();
+      }
+    }
+
+    void EndEdit() {
+      if (--edit_depth == 0) {
+        std::shared_ptr<Snapshot> next = std::move(pending);
+        next->grid.EndBatch();
+        if (!pending_edits.empty()) {
+          Publish(next);
+          for (auto& edit : pending_edits) {
+            NotifyEdit(edit.first, edit.second);
           }
+
+          pending_edits.clear();
         }
       }
 
-      box_store.erase(res);
+      sampler_lock.unlock();
+    }
 
-      return res;
+    // BeginEdit / EndEdit for a scope
+    class EditScope {
+     public:
+      EditScope(MultiSampler& sampler) : sampler_(sampler) {
+        sampler_.BeginEdit();
+      }
+
+      ~EditScope() {
+        sampler_.EndEdit();
+      }
+
+      EditScope(const EditScope&) = delete;
+      EditScope& operator=(const EditScope&) = delete;
+
+     private:
+      MultiSampler& sampler_;
+    };
+
+    /**
+     * @brief Registers a listener for box inserts / removes.
+     *        Listeners run on the editing thread, after the new snapshot is published, with the writer lock held -
+     *        keep them short, and don't edit this sampler from inside one.
+     *
+     * @return size_t - id for RemoveEditListener
+     */
+    size_t AddEditListener(edit_listener listener) {
+      std::lock_guard<std::recursive_mutex> lock(sampler_lock);
+      size_t id = next_listener_id++;
+      listeners.emplace_back(id, std::move(listener));
+      return id;
+    }
+
+    void RemoveEditListener(size_t id) {
+      std::lock_guard<std::recursive_mutex> lock(sampler_lock);
+      listeners.erase(std::remove_if(listeners.begin(), listeners.end(), [id](const auto& entry) { return entry.first == id; }), listeners.end());
     }
 
 
    private:
-    static constexpr glm::dvec2 DVEC_EPSILON = glm::dvec2(0.00001);
     void InsertBoxPointer(const std::shared_ptr<BoxType>& box) {
-      glm::dvec2 origin = box->origin;
-      glm::dvec2 end = box->GetEnd();
+      std::lock_guard<std::recursive_mutex> lock(sampler_lock);
 
-      glm::ivec2 chunk_floor = static_cast<glm::ivec2>(glm::floor((origin - DVEC_EPSILON) / static_cast<double>(_SAMPLER_CHUNK_SIZE)));
-      glm::ivec2 chunk_ceil = static_cast<glm::ivec2>(glm::ceil((end + DVEC_EPSILON) / static_cast<double>(_SAMPLER_CHUNK_SIZE)));
+      uint32_t id;
+      if (free_ids.empty()) {
+        id = next_id++;
+      } else {
+        id = free_ids.back();
+        free_ids.pop_back();
+      }
 
-      std::lock_guard<std::recursive_mutex> lock(sampler_lock);
-      for (int x = chunk_floor.x; x < chunk_ceil.x; x++) {
-        for (int y = chunk_floor.y; y < chunk_ceil.y; y++) {
-          glm::ivec2 chunk(x, y);
-          // need to test
-          InsertIntoChunk(chunk, box);
-        }
+      std::shared_ptr<Snapshot> next = BeginChange();
+      if (next->mode == IndexMode::QUADTREE) {
+        next->tree.Insert(id, box);
+      } else {
+        next->grid.Insert(id, box);
       }
+      next->id_capacity = next_id;
 
+      box_ids.emplace(box.get(), id);
       box_store.insert(box);
+      next->box_count = box_store.size();
+      EndChange(next, *box);
+    }
+
+    // writer only (sampler_lock held) - the snapshot an edit should modify
+    std::shared_ptr<Snapshot> BeginChange() {
+      return (edit_depth > 0 ? pending : CopySnapshot());
+    }
+
+    // writer only (sampler_lock held) - publishes an edit, or queues it up for EndEdit
+    void EndChange(const std::shared_ptr<Snapshot>& next, const BoxType& box) {
+      // falloff footprint (see FeatureBox::GetFalloffWeight_local) - tiny boxes still span 0.002
+      glm::dvec2 origin = box.GetOrigin();
+      glm::dvec2 size = glm::max(box.GetSize(), glm::dvec2(0.002));
+      if (edit_depth > 0) {
+        pending_edits.emplace_back(origin, size);
+        return;
+      }
+
+      Publish(next);
+      NotifyEdit(origin, size);
+    }
+
+    // writer only (sampler_lock held)
+    void NotifyEdit(const glm::dvec2& origin, const glm::dvec2& size) {
+      for (auto& entry : listeners) {
+        entry.second(origin, size);
+      }
+    }
+
+    // writer only (sampler_lock held) - shallow copy, cells are shared until touched
+    std::shared_ptr<Snapshot> CopySnapshot() const {
+      // only writers free holders, so no need to announce ourselves
+      std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>(**published_.load());
+      next->version++;
+      return next;
     }
-    // eff: i want "multisampler" to manage everything for me... but there's no way to spawn things atm
-    void InsertIntoChunk(const glm::ivec2& chunk, const std::shared_ptr<BoxType>& box) {
-      typename cache_type::iterator itr = chunk_lookup_cache.find(chunk);
-      if (itr == chunk_lookup_cache.end()) {
-        chunk_lookup_cache.insert(std::make_pair(chunk, std::unordered_set<std::shared_ptr<BoxType>> {}));
 
-        itr = chunk_lookup_cache.find(chunk);
+    // writer only (sampler_lock held)
+    void Publish(const std::shared_ptr<Snapshot>& next) {
+      const std::shared_ptr<const Snapshot>* old = published_.exchange(new std::shared_ptr<const Snapshot>(next));
+
+      // grace period: wait out every reader which could still be copying from old.
+      // flipping twice also catches readers which read the parity just before a flip.
+      // seq_cst (not acquire): readers increment, then load published_ - only a seq_cst load here
+      // is guaranteed to see an increment made by a reader which then read old
+      for (int i = 0; i < 2; i++) {
+        uint32_t parity = parity_.fetch_add(1) & 1;
+        while (readers_[parity].load() != 0) {
+          std::this_thread::yield();
+        }
       }
 
-      itr->second.insert(box);
+      delete old;
     }
 
+    // writers only - readers go through the snapshot
     mutable std::recursive_mutex sampler_lock;
 
+    // current snapshot - the holder is swapped out whole, so readers never see a half-written shared_ptr
+    std::atomic<const std::shared_ptr<const Snapshot>*> published_;
+
+    // readers mid-GetSnapshot, split by parity so a writer can wait out just the ones which started before it published
+    std::atomic<uint32_t> parity_ { 0 };
+    mutable std::atomic<uint32_t> readers_[2] = { { 0 }, { 0 } };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+    static_assert(std::atomic<const std::shared_ptr<const Snapshot>*>::is_always_lock_free);
+
+    // dense ids, handed out on insert and recycled on remove
+    std::unordered_map<const BoxType*, uint32_t> box_ids;
+    std::vector<uint32_t> free_ids;
+    uint32_t next_id = 0;
+
+    std::vector<std::pair<size_t, edit_listener>> listeners;
+    size_t next_listener_id = 0;
+
+    // open batch (see BeginEdit) - edits go into pending, and are published by the outermost EndEdit
+    int edit_depth = 0;
+    std::shared_ptr<Snapshot> pending;
+    std::vector<std::pair<glm::dvec2, glm::dvec2>> pending_edits;
+
    public:
 
-    cache_type chunk_lookup_cache;
     // no great way to handle, other than backing up with a dupe set
+    // (not synced w readers - iterate from a single thread, or use GetSnapshot for lookups)
     set_type   box_store;
 
     // (dupe'd shared ptr - about 24 bytes per, so assume like a few dozen extra KB :-])
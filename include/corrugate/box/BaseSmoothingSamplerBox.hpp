@@ -3,6 +3,7 @@
 
 #include "corrugate/box/SamplerBox.hpp"
 #include "corrugate/sampler/DataSampler.hpp"
+#include "corrugate/util/Workspace.hpp"
 
 namespace cg {
   class BaseSmoothingSamplerBox : virtual public SamplerBox {
@@ -21,6 +22,7 @@ namespace cg {
      * @param falloff_sums - sum of falloffs of all overlapping components, in dims space
      * @param output - float outputs for smoothed data
      * @param n_bytes - number of bytes
+     * @param workspace - caller's scratch
      * @return size_t - outputted delta to modify underlying terrain by
      */
     virtual size_t WriteSmoothDelta(
@@ -30,9 +32,23 @@ namespace cg {
       const DataSampler<float>& underlying_data,
       const DataSampler<float>& falloff_sums,
       float* output,
-      size_t n_bytes
+      size_t n_bytes,
+      Workspace& workspace
     ) const = 0;
 
+    // scratch from the thread-local workspace
+    size_t WriteSmoothDelta(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      const DataSampler<float>& underlying_data,
+      const DataSampler<float>& falloff_sums,
+      float* output,
+      size_t n_bytes
+    ) const {
+      return WriteSmoothDelta(origin, sample_dims, scale, underlying_data, falloff_sums, output, n_bytes, Workspace::Local());
+    }
+
     virtual ~BaseSmoothingSamplerBox() {}
   };
 }
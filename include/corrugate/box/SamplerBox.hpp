@@ -2,7 +2,9 @@
 #define SAMPLER_BOX_H_
 
 #include "corrugate/FeatureBox.hpp"
+#include "corrugate/sampler/ChunkLayers.hpp"
 #include "corrugate/sampler/DataSampler.hpp"
+#include "corrugate/util/Workspace.hpp"
 
 #include <glm/glm.hpp>
 
@@ -42,6 +44,38 @@ namespace cg {
     virtual size_t WriteHeight(   const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale,                float* output,      size_t n_bytes) const = 0;
     virtual size_t WriteSplat(    const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t index,  glm::vec4* output,  size_t n_bytes, const DataSampler<float>* falloffs) const = 0;
     virtual size_t WriteTreeFill( const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale,                float* output,      size_t n_bytes, const DataSampler<float>* falloffs) const = 0;
+
+    /**
+     * @brief Writes every layer in layers.mask for a chunk.
+     *        Default just calls the single layer writes - override to share work between layers.
+     *
+     * @param origin - global origin
+     * @param sample_dims - num of x/y samples
+     * @param scale - scale of sampling
+     * @param layers - outputs, each sized for sample_dims
+     * @param falloffs - falloff sum for the chunk (used by tree fill)
+     * @param workspace - caller's scratch, for any temps the box needs
+     * @return size_t - number of bytes written, across all layers
+     */
+    virtual size_t WriteLayers(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, const ChunkLayers& layers, const DataSampler<float>* falloffs, Workspace&) const {
+      size_t elems = static_cast<size_t>(sample_dims.x) * sample_dims.y;
+      size_t bytes = 0;
+      if (layers.Has(LAYER_HEIGHT)) {
+        bytes += WriteHeight(origin, sample_dims, scale, layers.height, elems * sizeof(float));
+      }
+
+      if (layers.Has(LAYER_SPLAT)) {
+        for (size_t i = 0; i < layers.splat_count; i++) {
+          bytes += WriteSplat(origin, sample_dims, scale, layers.splat_first + i, layers.splat + i * elems, elems * sizeof(glm::vec4), falloffs);
+        }
+      }
+
+      if (layers.Has(LAYER_TREE_FILL)) {
+        bytes += WriteTreeFill(origin, sample_dims, scale, layers.tree_fill, elems * sizeof(float), falloffs);
+      }
+
+      return bytes;
+    }
   };
 }
 
@@ -6,6 +6,9 @@
 #include "corrugate/box/BaseSmoothingSamplerBox.hpp"
 
 #include "corrugate/sampler/DataSampler.hpp"
+#include "corrugate/util/Workspace.hpp"
+
+#include <algorithm>
 
 namespace cg {
   // extend baseterrain
@@ -49,11 +52,11 @@ namespace cg {
       float falloff_dist,
       float smoothing_factor
     ) :
+    SamplerBox(origin, size, falloff_radius, falloff_dist),   // v base class ctor
     BaseTerrainBox(origin, size, heightmap, splat, fill, falloff_radius, falloff_dist),
     BaseSmoothingSamplerBox(origin, size, falloff_radius, falloff_dist),
-    SamplerBox(origin, size, falloff_radius, falloff_dist),   // v base class ctor
-    smoother(*this),
-    smoothing_factor(smoothing_factor) {
+    smoothing_factor(smoothing_factor),
+    smoother(*this) {
       smoother.smoothing_factor = smoothing_factor;
     }
 
@@ -62,8 +65,22 @@ namespace cg {
       smoother.PrepareCache(sampler);
     }
 
+    bool IsCachePrepared() const {
+      return smoother.IsCachePrepared();
+    }
+
+    bool GetSmoothingEstimate(SmoothingEstimate& output) const {
+      return smoother.GetEstimate(output);
+    }
+
+    void SetSmoothingEstimate(const SmoothingEstimate& estimate) {
+      smoother.SetEstimate(estimate);
+    }
+
     // this is handled before falloff!
     // ergo: we could work with linear values all the way
+    using BaseSmoothingSamplerBox::WriteSmoothDelta;
+
     float GetSmoothDelta(double x, double y, double underlying) const override {
       // do we want to return vanilla values
       glm::dvec2 origin = GetOrigin();
@@ -77,7 +94,8 @@ namespace cg {
       const DataSampler<float>& underlying_data,
       const DataSampler<float>& falloff_sums,
       float* output,
-      size_t n_bytes
+      size_t n_bytes,
+      Workspace& ws
     ) const override {
       size_t required_bytes = sample_dims.x * sample_dims.y * sizeof(float);
       if (required_bytes > n_bytes) {
@@ -97,16 +115,32 @@ namespace cg {
       glm::dvec2 local_origin = origin - GetOrigin();
       glm::dvec2 local_coord;
 
+      // nothing outside the footprint - skip smoothing there
+      std::fill(output, output + static_cast<size_t>(sample_dims.x) * sample_dims.y, 0.0f);
+
+      glm::ivec2 begin, end;
+      if (!GetFootprintSamples_local(local_origin, sample_dims, scale, begin, end)) {
+        return required_bytes;
+      }
+
       // falloff sum is a weighted average
       // after falloff: scale the whole thing by "falloff / falloff sum"
 
-      for (int y = 0; y < sample_dims.y; y++) {
+      Workspace::Scope scope(ws);
+
+      int count = end.x - begin.x;
+      float* weights = ws.Allocate<float>(count);
+
+      local_coord.x = local_origin.x + static_cast<double>(begin.x) * scale;
+      for (int y = begin.y; y < end.y; y++) {
         local_coord.y = local_origin.y + static_cast<double>(y) * scale;
-        for (int x = 0; x < sample_dims.x; x++) {
-          local_coord.x = local_origin.x + static_cast<double>(x) * scale;
-          float falloff = GetFalloffWeight_local(local_coord);
+        simd::WriteFalloffRow<false>(GetFalloffRow_local(local_coord, scale), count, weights);
+
+        float* row = output + static_cast<size_t>(y) * sample_dims.x;
+        for (int x = begin.x; x < end.x; x++) {
+          float falloff = weights[x - begin.x];
           float falloff_sum = std::max(falloff_sums.Get(x, y), 0.00001f);
-          output[y * sample_dims.x + x] = smoother.Smooth(underlying_data.Get(x, y)) * falloff * (falloff / falloff_sum);
+          row[x] = smoother.Smooth(underlying_data.Get(x, y)) * falloff * (falloff / falloff_sum);
         }
       }
 
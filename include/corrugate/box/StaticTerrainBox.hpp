@@ -0,0 +1,27 @@
+#ifndef STATIC_TERRAIN_BOX_H_
+#define STATIC_TERRAIN_BOX_H_
+
+#include "corrugate/box/TerrainBox.hpp"
+#include "corrugate/sampler/StaticTerrainSampler.hpp"
+
+namespace cg {
+  // terrain box with its sampler types fixed at compile time
+  // - per-sample calls inline, only the per-chunk box call is virtual
+  template <typename HeightType, typename SplatType, typename FillType>
+  class StaticTerrainBox : public TerrainBox<StaticTerrainSampler<HeightType, SplatType, FillType>> {
+    typedef StaticTerrainSampler<HeightType, SplatType, FillType> sampler_type;
+   public:
+    StaticTerrainBox(
+      const glm::dvec2& origin,
+      const glm::dvec2& size,
+      std::shared_ptr<HeightType> heightmap,
+      std::shared_ptr<SplatType> splat,
+      std::shared_ptr<FillType> fill,
+      float falloff_radius,
+      float falloff_dist
+    ) : SamplerBox(origin, size, falloff_radius, falloff_dist),
+        TerrainBox<sampler_type>(origin, size, sampler_type(heightmap, splat, fill), falloff_radius, falloff_dist) {}
+  };
+}
+
+#endif // STATIC_TERRAIN_BOX_H_
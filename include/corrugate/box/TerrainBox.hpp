@@ -0,0 +1,279 @@
+#ifndef TERRAIN_BOX_H_
+#define TERRAIN_BOX_H_
+
+#include "corrugate/box/SamplerBox.hpp"
+#include "corrugate/util/Workspace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace cg {
+  /**
+   * @brief Terrain box over any terrain sampler type.
+   *        SamplerType provides SampleHeight/SampleSplat/SampleTreeFill and WriteHeight/WriteSplat/WriteTreeFill,
+   *        all in box-local coords - see BaseTerrainSampler (type erased) and StaticTerrainSampler (inlined).
+   */
+  template <typename SamplerType>
+  class TerrainBox : virtual public SamplerBox {
+   public:
+    TerrainBox(
+      const glm::dvec2& origin,
+      const glm::dvec2& size,
+      SamplerType&& sampler,
+      float falloff_radius,
+      float falloff_dist
+    ) : SamplerBox(origin, size, falloff_radius, falloff_dist),
+        sampler(std::move(sampler)) {}
+
+    float SampleHeight(double x, double y)                   const override {
+      // tba: need to handle falloff in all of these
+      auto origin = GetOrigin();
+      glm::dvec2 local_coord(x - origin.x, y - origin.y);
+
+      float falloff_weight = GetFalloffWeight_local(local_coord);
+      return sampler.SampleHeight(local_coord.x, local_coord.y) * falloff_weight;
+    };
+
+    glm::vec4 SampleSplat(double x, double y, size_t index)     const override {
+      auto origin = GetOrigin();
+      glm::dvec2 local_coord(x - origin.x, y - origin.y);
+  
+      float falloff_weight = GetFalloffWeight_local(local_coord);
+      return sampler.SampleSplat(local_coord.x, local_coord.y, index) * falloff_weight;
+    };
+
+    float SampleTreeFill( double x, double y)                   const override {
+      auto origin = GetOrigin();
+      glm::dvec2 local_coord(x - origin.x, y - origin.y);
+
+      float falloff_weight = GetFalloffWeight_local(local_coord);
+      return sampler.SampleTreeFill(local_coord.x, local_coord.y) * falloff_weight;
+    };
+
+
+    size_t WriteHeight(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      float* output,
+      size_t n_bytes
+    ) const override {
+      return WriteClipped<float>(origin, sample_dims, scale, output, n_bytes, nullptr,
+        [&](const glm::dvec2& sub_origin, const glm::ivec2& sub_dims, float* sub_output, size_t sub_bytes) {
+          return sampler.WriteHeight(sub_origin, sub_dims, scale, sub_output, sub_bytes);
+        }
+      );
+    };
+
+    size_t WriteSplat(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      size_t index,
+      glm::vec4* output,
+      size_t n_bytes,
+      const DataSampler<float>*
+    ) const override {
+      // test: don't apply falloff to splat data - think it's avg'ing
+      return WriteClipped<glm::vec4>(origin, sample_dims, scale, output, n_bytes, nullptr,
+        [&](const glm::dvec2& sub_origin, const glm::ivec2& sub_dims, glm::vec4* sub_output, size_t sub_bytes) {
+          return sampler.WriteSplat(sub_origin, sub_dims, scale, index, sub_output, sub_bytes);
+        }
+      );
+    };
+
+    size_t WriteTreeFill(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      float* output,
+      size_t n_bytes,
+      const DataSampler<float>* falloffs
+    ) const override {
+      return WriteClipped<float>(origin, sample_dims, scale, output, n_bytes, falloffs,
+        [&](const glm::dvec2& sub_origin, const glm::ivec2& sub_dims, float* sub_output, size_t sub_bytes) {
+          return sampler.WriteTreeFill(sub_origin, sub_dims, scale, sub_output, sub_bytes);
+        }
+      );
+    };
+
+    // falloff weights are evaluated once over the footprint, then applied to every layer
+    size_t WriteLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      const ChunkLayers& layers,
+      const DataSampler<float>* falloffs,
+      Workspace& ws
+    ) const override {
+      glm::dvec2 origin_relative = origin - GetOrigin();
+
+      glm::ivec2 begin, end;
+      bool covered = GetFootprintSamples_local(origin_relative, sample_dims, scale, begin, end);
+
+      Workspace::Scope scope(ws);
+      float* weights = (covered ? ws.Allocate<float>(static_cast<size_t>(end.x - begin.x) * (end.y - begin.y)) : nullptr);
+      if (covered) {
+        WriteFootprintWeights(origin_relative, scale, begin, end, weights);
+      }
+
+      size_t bytes = 0;
+      if (layers.Has(LAYER_HEIGHT)) {
+        bytes += WriteFootprint<float>(origin_relative, sample_dims, scale, covered, begin, end, weights, layers.height, nullptr,
+          [&](const glm::dvec2& sub_origin, const glm::ivec2& sub_dims, float* sub_output, size_t sub_bytes) {
+            return sampler.WriteHeight(sub_origin, sub_dims, scale, sub_output, sub_bytes);
+          }
+        );
+      }
+
+      if (layers.Has(LAYER_SPLAT) && layers.splat_count > 0) {
+        // every index in one sampler call
+        bytes += WriteFootprint<glm::vec4>(origin_relative, sample_dims, scale, covered, begin, end, weights, layers.splat, nullptr,
+          [&](const glm::dvec2& sub_origin, const glm::ivec2& sub_dims, glm::vec4* sub_output, size_t sub_bytes) {
+            return sampler.WriteSplatLayers(sub_origin, sub_dims, scale, layers.splat_first, layers.splat_count, sub_output, sub_bytes);
+          },
+          layers.splat_count
+        );
+      }
+
+      if (layers.Has(LAYER_TREE_FILL)) {
+        bytes += WriteFootprint<float>(origin_relative, sample_dims, scale, covered, begin, end, weights, layers.tree_fill, falloffs,
+          [&](const glm::dvec2& sub_origin, const glm::ivec2& sub_dims, float* sub_output, size_t sub_bytes) {
+            return sampler.WriteTreeFill(sub_origin, sub_dims, scale, sub_output, sub_bytes);
+          }
+        );
+      }
+
+      return bytes;
+    }
+
+   private:
+    SamplerType sampler;
+
+    // single layer write - see WriteFootprint
+    template <typename DataType, typename WriteFunc>
+    size_t WriteClipped(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      DataType* output,
+      size_t n_bytes,
+      const DataSampler<float>* falloffs,
+      WriteFunc&& write
+    ) const {
+      if (static_cast<size_t>(sample_dims.x) * sample_dims.y * sizeof(DataType) > n_bytes) {
+        return 0;
+      }
+
+      // get sampling origin relative
+      glm::dvec2 origin_relative = origin - GetOrigin();
+
+      glm::ivec2 begin, end;
+      bool covered = GetFootprintSamples_local(origin_relative, sample_dims, scale, begin, end);
+
+      Workspace& ws = Workspace::Local();
+      Workspace::Scope scope(ws);
+      float* weights = (covered ? ws.Allocate<float>(static_cast<size_t>(end.x - begin.x) * (end.y - begin.y)) : nullptr);
+      if (covered) {
+        WriteFootprintWeights(origin_relative, scale, begin, end, weights);
+      }
+
+      return WriteFootprint<DataType>(origin_relative, sample_dims, scale, covered, begin, end, weights, output, falloffs, std::forward<WriteFunc>(write));
+    }
+
+    // falloff weights for the samples in [begin, end), packed
+    void WriteFootprintWeights(const glm::dvec2& origin_relative, double scale, const glm::ivec2& begin, const glm::ivec2& end, float* weights) const {
+      int count = end.x - begin.x;
+      for (int y = begin.y; y < end.y; y++) {
+        // specify origin in local coords
+        glm::dvec2 row_start(static_cast<double>(begin.x) * scale + origin_relative.x, static_cast<double>(y) * scale + origin_relative.y);
+        simd::WriteFalloffRow<false>(GetFalloffRow_local(row_start, scale), count, weights + static_cast<size_t>(y - begin.y) * count);
+      }
+    }
+
+    // only samples the part of the chunk covered by the box footprint - everything else is 0
+    // - sub rect is written packed to the front of output, then spread out to its place in the chunk
+    // - planes: number of chunk-sized planes written back to back (splat layers)
+    template <typename DataType, typename WriteFunc>
+    size_t WriteFootprint(
+      const glm::dvec2& origin_relative,
+      const glm::ivec2& sample_dims,
+      double scale,
+      bool covered,
+      const glm::ivec2& begin,
+      const glm::ivec2& end,
+      const float* weights,
+      DataType* output,
+      const DataSampler<float>* falloffs,
+      WriteFunc&& write,
+      size_t planes = 1
+    ) const {
+      size_t elems = static_cast<size_t>(sample_dims.x) * sample_dims.y;
+      size_t bytes = elems * planes * sizeof(DataType);
+
+      if (!covered) {
+        std::fill(output, output + elems * planes, DataType(0));
+        return bytes;
+      }
+
+      glm::ivec2 sub_dims = end - begin;
+      size_t sub_elems = static_cast<size_t>(sub_dims.x) * sub_dims.y;
+      size_t sub_bytes = sub_elems * planes * sizeof(DataType);
+      glm::dvec2 sub_origin = origin_relative + glm::dvec2(begin) * scale;
+
+      if (write(sub_origin, sub_dims, output, sub_bytes) != sub_bytes) {
+        return 0;
+      }
+
+      // back to front, so packed rows are never overwritten before they're moved
+      for (size_t p = planes; p-- > 0;) {
+        DataType* plane = output + p * elems;
+        const DataType* packed = output + p * sub_elems;
+
+        if (sub_dims != sample_dims) {
+          for (int y = sub_dims.y - 1; y >= 0; y--) {
+            DataType* dst = plane + static_cast<size_t>(begin.y + y) * sample_dims.x + begin.x;
+            memmove(dst, packed + static_cast<size_t>(y) * sub_dims.x, sub_dims.x * sizeof(DataType));
+          }
+
+          // zero everything outside the sub rect
+          std::fill(plane, plane + static_cast<size_t>(begin.y) * sample_dims.x, DataType(0));
+          for (int y = begin.y; y < end.y; y++) {
+            DataType* row = plane + static_cast<size_t>(y) * sample_dims.x;
+            std::fill(row, row + begin.x, DataType(0));
+            std::fill(row + end.x, row + sample_dims.x, DataType(0));
+          }
+
+          std::fill(plane + static_cast<size_t>(end.y) * sample_dims.x, plane + elems, DataType(0));
+        }
+
+        ApplyFalloff<DataType>(sample_dims, begin, end, weights, plane, falloffs);
+      }
+
+      return bytes;
+    }
+
+    // applies packed weights to the samples in [begin, end) of a chunk
+    template <typename FalloffDataType>
+    void ApplyFalloff(const glm::ivec2& sample_dims, const glm::ivec2& begin, const glm::ivec2& end, const float* weights, FalloffDataType* output, const DataSampler<float>* falloffs) const {
+      int count = end.x - begin.x;
+      for (int y = begin.y; y < end.y; y++) {
+        const float* row_weights = weights + static_cast<size_t>(y - begin.y) * count;
+        FalloffDataType* row = output + static_cast<size_t>(y) * sample_dims.x + begin.x;
+        if (falloffs != nullptr) {
+          // multiply by falloff weight, then scale based on pct of total
+          for (int x = 0; x < count; x++) {
+            row[x] *= row_weights[x] * (row_weights[x] / std::max(falloffs->Get(begin.x + x, y), 0.00001f));
+          }
+        } else {
+          for (int x = 0; x < count; x++) {
+            row[x] *= row_weights[x];
+          }
+        }
+      }
+    }
+  };
+}
+
+#endif // TERRAIN_BOX_H_
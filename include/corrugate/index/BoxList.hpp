@@ -0,0 +1,177 @@
+#ifndef CG_BOX_LIST_H_
+#define CG_BOX_LIST_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace cg {
+  namespace index {
+    /**
+     * @brief Packed list of boxes.
+     *        Bounds are stored as structure-of-arrays so the overlap test streams through
+     *        four flat arrays (and can test 2-4 boxes per instruction) instead of
+     *        dereferencing every box.
+     */
+    template <typename BoxType>
+    class BoxList {
+     public:
+      void Insert(uint32_t id, const std::shared_ptr<BoxType>& box) {
+        glm::dvec2 origin = box->GetOrigin();
+        glm::dvec2 end = box->GetEnd();
+
+        min_x.push_back(origin.x);
+        min_y.push_back(origin.y);
+        max_x.push_back(end.x);
+        max_y.push_back(end.y);
+        ids.push_back(id);
+        boxes.push_back(box);
+      }
+
+      // swap-remove - order isn't meaningful
+      bool Remove(uint32_t id) {
+        for (size_t i = 0; i < ids.size(); i++) {
+          if (ids[i] == id) {
+            size_t last = ids.size() - 1;
+            min_x[i] = min_x[last];
+            min_y[i] = min_y[last];
+            max_x[i] = max_x[last];
+            max_y[i] = max_y[last];
+            ids[i] = ids[last];
+            boxes[i] = std::move(boxes[last]);
+
+            min_x.pop_back();
+            min_y.pop_back();
+            max_x.pop_back();
+            max_y.pop_back();
+            ids.pop_back();
+            boxes.pop_back();
+            return true;
+          }
+        }
+
+        return false;
+      }
+
+      size_t size() const {
+        return ids.size();
+      }
+
+      bool empty() const {
+        return ids.empty();
+      }
+
+      /**
+       * @brief Calls callback(slot) for every box overlapping [origin, end) (strict overlap).
+       */
+      template <typename Callback>
+      void Query(const glm::dvec2& origin, const glm::dvec2& end, Callback&& callback) const {
+        const size_t count = ids.size();
+        size_t i = 0;
+
+#if defined(__AVX__)
+        const __m256d q_min_x = _mm256_set1_pd(origin.x);
+        const __m256d q_min_y = _mm256_set1_pd(origin.y);
+        const __m256d q_max_x = _mm256_set1_pd(end.x);
+        const __m256d q_max_y = _mm256_set1_pd(end.y);
+        for (; i + 4 <= count; i += 4) {
+          __m256d hit = _mm256_and_pd(
+            _mm256_and_pd(
+              _mm256_cmp_pd(_mm256_loadu_pd(&min_x[i]), q_max_x, _CMP_LT_OQ),
+              _mm256_cmp_pd(_mm256_loadu_pd(&min_y[i]), q_max_y, _CMP_LT_OQ)
+            ),
+            _mm256_and_pd(
+              _mm256_cmp_pd(_mm256_loadu_pd(&max_x[i]), q_min_x, _CMP_GT_OQ),
+              _mm256_cmp_pd(_mm256_loadu_pd(&max_y[i]), q_min_y, _CMP_GT_OQ)
+            )
+          );
+
+          int mask = _mm256_movemask_pd(hit);
+          while (mask != 0) {
+            int bit = __builtin_ctz(mask);
+            callback(i + bit);
+            mask &= mask - 1;
+          }
+        }
+#elif defined(__SSE2__)
+        const __m128d q_min_x = _mm_set1_pd(origin.x);
+        const __m128d q_min_y = _mm_set1_pd(origin.y);
+        const __m128d q_max_x = _mm_set1_pd(end.x);
+        const __m128d q_max_y = _mm_set1_pd(end.y);
+        for (; i + 2 <= count; i += 2) {
+          __m128d hit = _mm_and_pd(
+            _mm_and_pd(
+              _mm_cmplt_pd(_mm_loadu_pd(&min_x[i]), q_max_x),
+              _mm_cmplt_pd(_mm_loadu_pd(&min_y[i]), q_max_y)
+            ),
+            _mm_and_pd(
+              _mm_cmpgt_pd(_mm_loadu_pd(&max_x[i]), q_min_x),
+              _mm_cmpgt_pd(_mm_loadu_pd(&max_y[i]), q_min_y)
+            )
+          );
+
+          int mask = _mm_movemask_pd(hit);
+          if (mask & 1) callback(i);
+          if (mask & 2) callback(i + 1);
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        const float64x2_t q_min_x = vdupq_n_f64(origin.x);
+        const float64x2_t q_min_y = vdupq_n_f64(origin.y);
+        const float64x2_t q_max_x = vdupq_n_f64(end.x);
+        const float64x2_t q_max_y = vdupq_n_f64(end.y);
+        for (; i + 2 <= count; i += 2) {
+          uint64x2_t hit = vandq_u64(
+            vandq_u64(
+              vcltq_f64(vld1q_f64(&min_x[i]), q_max_x),
+              vcltq_f64(vld1q_f64(&min_y[i]), q_max_y)
+            ),
+            vandq_u64(
+              vcgtq_f64(vld1q_f64(&max_x[i]), q_min_x),
+              vcgtq_f64(vld1q_f64(&max_y[i]), q_min_y)
+            )
+          );
+
+          if (vgetq_lane_u64(hit, 0)) callback(i);
+          if (vgetq_lane_u64(hit, 1)) callback(i + 1);
+        }
+#endif
+
+        for (; i < count; i++) {
+          if (
+               min_x[i] < end.x     && min_y[i] < end.y
+            && max_x[i] > origin.x  && max_y[i] > origin.y
+          ) {
+            callback(i);
+          }
+        }
+      }
+
+      size_t GetMemoryUsage() const {
+        return sizeof(BoxList)
+          + (min_x.capacity() + min_y.capacity() + max_x.capacity() + max_y.capacity()) * sizeof(double)
+          + ids.capacity() * sizeof(uint32_t)
+          + boxes.capacity() * sizeof(std::shared_ptr<BoxType>);
+      }
+
+      // bounds (soa)
+      std::vector<double> min_x;
+      std::vector<double> min_y;
+      std::vector<double> max_x;
+      std::vector<double> max_y;
+
+      // parallel to bounds - only touched on a hit
+      std::vector<uint32_t> ids;
+      std::vector<std::shared_ptr<BoxType>> boxes;
+    };
+  }
+}
+
+#endif // CG_BOX_LIST_H_
@@ -0,0 +1,259 @@
+#ifndef CG_GRID_INDEX_H_
+#define CG_GRID_INDEX_H_
+
+#include "corrugate/index/BoxList.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// cells per page side - the cell table is shared and copied a page at a time
+#ifndef _GRID_PAGE_SIZE
+#define _GRID_PAGE_SIZE 8
+#endif
+
+namespace cg {
+  namespace index {
+    /**
+     * @brief Flat grid of box lists.
+     *        Cells are grouped into _GRID_PAGE_SIZE^2 pages, stored in a dense row-major table
+     *        covering every page touched so far, so a lookup is index math rather than a hash probe.
+     *
+     *        Copying a grid is shallow - it copies the page table (one pointer per page), and pages and cells
+     *        are shared. Insert/Remove replace (copy on write) only the pages and cells they touch.
+     *        This is what lets MultiSampler publish new versions without disturbing readers of the old one.
+     *
+     *        Between BeginBatch and EndBatch, pages and cells already copied during the batch are edited in place,
+     *        so a batch of edits copies each page / cell it touches once. Don't copy a grid mid-batch -
+     *        the copy would share pages which are still being edited.
+     */
+    template <typename BoxType>
+    class GridIndex {
+      struct Cell {
+        BoxList<BoxType> boxes;
+        // batch which copied this cell (0: none)
+        uint64_t batch = 0;
+      };
+
+      struct Page {
+        std::shared_ptr<const Cell> cells[_GRID_PAGE_SIZE * _GRID_PAGE_SIZE];
+        uint64_t batch = 0;
+      };
+
+     public:
+      GridIndex(double cell_size) : cell_size_(cell_size), page_min_(0), page_dims_(0) {}
+
+      void Insert(uint32_t id, const std::shared_ptr<BoxType>& box) {
+        glm::ivec2 floor = CellFloor(box->GetOrigin());
+        glm::ivec2 ceil = CellCeil(box->GetEnd());
+        Reserve(floor, ceil);
+
+        for (int y = floor.y; y < ceil.y; y++) {
+          for (int x = floor.x; x < ceil.x; x++) {
+            GetMutableCell(x, y)->boxes.Insert(id, box);
+          }
+        }
+      }
+
+      void Remove(uint32_t id, const std::shared_ptr<BoxType>& box) {
+        glm::ivec2 floor = glm::max(CellFloor(box->GetOrigin()), page_min_ * _GRID_PAGE_SIZE);
+        glm::ivec2 ceil = glm::min(CellCeil(box->GetEnd()), (page_min_ + page_dims_) * _GRID_PAGE_SIZE);
+
+        for (int y = floor.y; y < ceil.y; y++) {
+          for (int x = floor.x; x < ceil.x; x++) {
+            const Cell* cell = GetCell(x, y);
+            if (cell == nullptr) {
+              continue;
+            }
+
+            // check before copying - removes which miss a cell shouldn't copy its page
+            const std::vector<uint32_t>& ids = cell->boxes.ids;
+            if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
+              continue;
+            }
+
+            Page* page = GetMutablePage(x, y);
+            std::shared_ptr<const Cell>& slot = page->cells[PageOffset(x, y)];
+            Cell* copy = GetMutableCell(slot);
+            copy->boxes.Remove(id);
+            if (copy->boxes.empty()) {
+              slot = nullptr;
+            }
+          }
+        }
+      }
+
+      /**
+       * @brief Calls callback(id, box) once for every box overlapping [origin, end).
+       *        Boxes spanning several cells are only reported from the cell containing
+       *        the min corner of their overlap with the query, so there's no need to dedupe.
+       */
+      template <typename Callback>
+      void Query(const glm::dvec2& origin, const glm::dvec2& end, Callback&& callback) const {
+        glm::ivec2 floor = glm::max(CellFloor(origin), page_min_ * _GRID_PAGE_SIZE);
+        glm::ivec2 ceil = glm::min(CellCeil(end), (page_min_ + page_dims_) * _GRID_PAGE_SIZE);
+
+        for (int y = floor.y; y < ceil.y; y++) {
+          for (int x = floor.x; x < ceil.x; x++) {
+            const Cell* cell = GetCell(x, y);
+            if (cell == nullptr) {
+              continue;
+            }
+
+            const BoxList<BoxType>& boxes = cell->boxes;
+            boxes.Query(origin, end, [&](size_t slot) {
+              // reference point: min corner of the overlap
+              int ref_x = static_cast<int>(std::floor(std::max(boxes.min_x[slot], origin.x) / cell_size_));
+              int ref_y = static_cast<int>(std::floor(std::max(boxes.min_y[slot], origin.y) / cell_size_));
+              if (ref_x == x && ref_y == y) {
+                callback(boxes.ids[slot], boxes.boxes[slot]);
+              }
+            });
+          }
+        }
+      }
+
+      // edits until EndBatch may modify the pages / cells they've already copied in place
+      void BeginBatch() {
+        // unique across every grid, so a batch never matches pages copied by some other batch
+        static std::atomic<uint64_t> next_batch(1);
+        batch_ = next_batch.fetch_add(1);
+      }
+
+      void EndBatch() {
+        batch_ = 0;
+      }
+
+      size_t GetMemoryUsage() const {
+        size_t bytes = sizeof(GridIndex) + pages_.capacity() * sizeof(std::shared_ptr<const Page>);
+        for (auto& page : pages_) {
+          if (!page) {
+            continue;
+          }
+
+          bytes += sizeof(Page);
+          for (auto& cell : page->cells) {
+            if (cell) {
+              bytes += sizeof(Cell) - sizeof(BoxList<BoxType>) + cell->boxes.GetMemoryUsage();
+            }
+          }
+        }
+
+        return bytes;
+      }
+
+     private:
+      static constexpr double CELL_EPSILON = 0.00001;
+
+      glm::ivec2 CellFloor(const glm::dvec2& point) const {
+        return glm::ivec2(
+          static_cast<int>(std::floor((point.x - CELL_EPSILON) / cell_size_)),
+          static_cast<int>(std::floor((point.y - CELL_EPSILON) / cell_size_))
+        );
+      }
+
+      glm::ivec2 CellCeil(const glm::dvec2& point) const {
+        return glm::ivec2(
+          static_cast<int>(std::ceil((point.x + CELL_EPSILON) / cell_size_)),
+          static_cast<int>(std::ceil((point.y + CELL_EPSILON) / cell_size_))
+        );
+      }
+
+      // page holding a cell (rounds toward -inf)
+      static int PageCoord(int cell) {
+        return (cell >= 0 ? cell / _GRID_PAGE_SIZE : (cell + 1) / _GRID_PAGE_SIZE - 1);
+      }
+
+      static size_t PageOffset(int x, int y) {
+        int local_x = x - PageCoord(x) * _GRID_PAGE_SIZE;
+        int local_y = y - PageCoord(y) * _GRID_PAGE_SIZE;
+        return static_cast<size_t>(local_y) * _GRID_PAGE_SIZE + local_x;
+      }
+
+      // cell (x, y) must lie inside the table
+      size_t PageIndex(int x, int y) const {
+        return static_cast<size_t>(PageCoord(y) - page_min_.y) * page_dims_.x + (PageCoord(x) - page_min_.x);
+      }
+
+      const Cell* GetCell(int x, int y) const {
+        const Page* page = pages_[PageIndex(x, y)].get();
+        return (page != nullptr ? page->cells[PageOffset(x, y)].get() : nullptr);
+      }
+
+      // copies the page holding (x, y) unless this batch already did
+      Page* GetMutablePage(int x, int y) {
+        std::shared_ptr<const Page>& slot = pages_[PageIndex(x, y)];
+        if (slot && batch_ != 0 && slot->batch == batch_) {
+          return const_cast<Page*>(slot.get());
+        }
+
+        std::shared_ptr<Page> copy = (slot ? std::make_shared<Page>(*slot) : std::make_shared<Page>());
+        copy->batch = batch_;
+        slot = copy;
+        return copy.get();
+      }
+
+      Cell* GetMutableCell(std::shared_ptr<const Cell>& slot) {
+        if (slot && batch_ != 0 && slot->batch == batch_) {
+          return const_cast<Cell*>(slot.get());
+        }
+
+        std::shared_ptr<Cell> copy = (slot ? std::make_shared<Cell>(*slot) : std::make_shared<Cell>());
+        copy->batch = batch_;
+        slot = copy;
+        return copy.get();
+      }
+
+      Cell* GetMutableCell(int x, int y) {
+        return GetMutableCell(GetMutablePage(x, y)->cells[PageOffset(x, y)]);
+      }
+
+      // grow the page table to cover cells [floor, ceil)
+      void Reserve(const glm::ivec2& floor, const glm::ivec2& ceil) {
+        glm::ivec2 page_floor(PageCoord(floor.x), PageCoord(floor.y));
+        glm::ivec2 page_ceil(PageCoord(ceil.x - 1) + 1, PageCoord(ceil.y - 1) + 1);
+        if (pages_.empty()) {
+          page_min_ = page_floor;
+          page_dims_ = page_ceil - page_floor;
+          pages_.resize(static_cast<size_t>(page_dims_.x) * page_dims_.y);
+          return;
+        }
+
+        glm::ivec2 new_min = glm::min(page_floor, page_min_);
+        glm::ivec2 new_max = glm::max(page_ceil, page_min_ + page_dims_);
+        if (new_min == page_min_ && new_max == page_min_ + page_dims_) {
+          return;
+        }
+
+        glm::ivec2 new_dims = new_max - new_min;
+        std::vector<std::shared_ptr<const Page>> resized(static_cast<size_t>(new_dims.x) * new_dims.y);
+        for (int y = 0; y < page_dims_.y; y++) {
+          for (int x = 0; x < page_dims_.x; x++) {
+            size_t dst = static_cast<size_t>(y + page_min_.y - new_min.y) * new_dims.x + (x + page_min_.x - new_min.x);
+            resized[dst] = std::move(pages_[static_cast<size_t>(y) * page_dims_.x + x]);
+          }
+        }
+
+        pages_ = std::move(resized);
+        page_min_ = new_min;
+        page_dims_ = new_dims;
+      }
+
+      double cell_size_;
+      // page table bounds, in pages
+      glm::ivec2 page_min_;
+      glm::ivec2 page_dims_;
+      std::vector<std::shared_ptr<const Page>> pages_;
+
+      // current batch (0: not batching - every edit copies)
+      uint64_t batch_ = 0;
+    };
+  }
+}
+
+#endif // CG_GRID_INDEX_H_
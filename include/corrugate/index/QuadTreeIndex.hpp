@@ -0,0 +1,192 @@
+#ifndef CG_QUAD_TREE_INDEX_H_
+#define CG_QUAD_TREE_INDEX_H_
+
+#include "corrugate/index/BoxList.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+// half-width of the area covered by the tree, centered on the world origin
+// (boxes centered outside of it just live in the root)
+#ifndef _SAMPLER_TREE_EXTENT
+#define _SAMPLER_TREE_EXTENT 1048576.0
+#endif
+
+// nodes stop splitting once they reach this size
+#ifndef _SAMPLER_TREE_MIN_SIZE
+#define _SAMPLER_TREE_MIN_SIZE 256.0
+#endif
+
+namespace cg {
+  namespace index {
+    /**
+     * @brief Loose quadtree.
+     *        Every box lives in exactly one node - the deepest node whose loose bounds (2x the node)
+     *        contain it - so large boxes sit near the root instead of being copied into hundreds of cells,
+     *        and small queries only walk the handful of nodes they overlap.
+     *
+     *        Nodes are immutable once built. Insert/Remove copy the path from the root to the
+     *        affected node (persistent tree), so copying an index is just a pointer copy.
+     */
+    template <typename BoxType>
+    class QuadTreeIndex {
+      struct Node {
+        std::shared_ptr<const BoxList<BoxType>> boxes;
+        std::shared_ptr<const Node> children[4];
+
+        bool empty() const {
+          return !boxes && !children[0] && !children[1] && !children[2] && !children[3];
+        }
+      };
+
+     public:
+      void Insert(uint32_t id, const std::shared_ptr<BoxType>& box) {
+        root_ = InsertNode(root_.get(), glm::dvec2(0.0), _SAMPLER_TREE_EXTENT, id, box);
+      }
+
+      void Remove(uint32_t id, const std::shared_ptr<BoxType>& box) {
+        if (root_) {
+          root_ = RemoveNode(root_.get(), glm::dvec2(0.0), _SAMPLER_TREE_EXTENT, id, box);
+        }
+      }
+
+      /**
+       * @brief Calls callback(id, box) once for every box overlapping [origin, end).
+       */
+      template <typename Callback>
+      void Query(const glm::dvec2& origin, const glm::dvec2& end, Callback&& callback) const {
+        if (root_) {
+          QueryNode(root_.get(), glm::dvec2(0.0), _SAMPLER_TREE_EXTENT, origin, end, callback);
+        }
+      }
+
+      size_t GetMemoryUsage() const {
+        return sizeof(QuadTreeIndex) + NodeMemory(root_.get());
+      }
+
+      size_t GetNodeCount() const {
+        return NodeCount(root_.get());
+      }
+
+     private:
+      // picks the child a box descends into, or -1 if it belongs in this node
+      static int ChildIndex(const glm::dvec2& center, double half, const std::shared_ptr<BoxType>& box) {
+        glm::dvec2 size = box->GetSize();
+        glm::dvec2 box_center = box->GetOrigin() + size * 0.5;
+        double child_half = half * 0.5;
+
+        if (child_half < _SAMPLER_TREE_MIN_SIZE * 0.5 || std::max(size.x, size.y) * 0.5 > child_half) {
+          return -1;
+        }
+
+        if (glm::abs(box_center.x - center.x) >= half || glm::abs(box_center.y - center.y) >= half) {
+          // outside the root
+          return -1;
+        }
+
+        return (box_center.x >= center.x ? 1 : 0) | (box_center.y >= center.y ? 2 : 0);
+      }
+
+      static glm::dvec2 ChildCenter(const glm::dvec2& center, double half, int child) {
+        double offset = half * 0.5;
+        return glm::dvec2(
+          center.x + ((child & 1) ? offset : -offset),
+          center.y + ((child & 2) ? offset : -offset)
+        );
+      }
+
+      static std::shared_ptr<const Node> InsertNode(const Node* node, const glm::dvec2& center, double half, uint32_t id, const std::shared_ptr<BoxType>& box) {
+        std::shared_ptr<Node> copy = (node != nullptr ? std::make_shared<Node>(*node) : std::make_shared<Node>());
+
+        int child = ChildIndex(center, half, box);
+        if (child < 0) {
+          std::shared_ptr<BoxList<BoxType>> boxes = (copy->boxes ? std::make_shared<BoxList<BoxType>>(*copy->boxes) : std::make_shared<BoxList<BoxType>>());
+          boxes->Insert(id, box);
+          copy->boxes = boxes;
+        } else {
+          copy->children[child] = InsertNode(copy->children[child].get(), ChildCenter(center, half, child), half * 0.5, id, box);
+        }
+
+        return copy;
+      }
+
+      static std::shared_ptr<const Node> RemoveNode(const Node* node, const glm::dvec2& center, double half, uint32_t id, const std::shared_ptr<BoxType>& box) {
+        std::shared_ptr<Node> copy = std::make_shared<Node>(*node);
+
+        int child = ChildIndex(center, half, box);
+        if (child < 0) {
+          if (copy->boxes) {
+            std::shared_ptr<BoxList<BoxType>> boxes = std::make_shared<BoxList<BoxType>>(*copy->boxes);
+            boxes->Remove(id);
+            copy->boxes = (boxes->empty() ? nullptr : boxes);
+          }
+        } else if (copy->children[child]) {
+          copy->children[child] = RemoveNode(copy->children[child].get(), ChildCenter(center, half, child), half * 0.5, id, box);
+        }
+
+        // prune empty branches
+        return (copy->empty() ? nullptr : copy);
+      }
+
+      template <typename Callback>
+      static void QueryNode(const Node* node, const glm::dvec2& center, double half, const glm::dvec2& origin, const glm::dvec2& end, Callback& callback) {
+        if (node->boxes) {
+          const BoxList<BoxType>& boxes = *node->boxes;
+          boxes.Query(origin, end, [&](size_t slot) {
+            callback(boxes.ids[slot], boxes.boxes[slot]);
+          });
+        }
+
+        double child_half = half * 0.5;
+        for (int i = 0; i < 4; i++) {
+          const Node* child = node->children[i].get();
+          if (child == nullptr) {
+            continue;
+          }
+
+          // loose bounds: twice the size of the child
+          glm::dvec2 child_center = ChildCenter(center, half, i);
+          if (
+               child_center.x - half < end.x     && child_center.y - half < end.y
+            && child_center.x + half > origin.x  && child_center.y + half > origin.y
+          ) {
+            QueryNode(child, child_center, child_half, origin, end, callback);
+          }
+        }
+      }
+
+      static size_t NodeMemory(const Node* node) {
+        if (node == nullptr) {
+          return 0;
+        }
+
+        size_t bytes = sizeof(Node) + (node->boxes ? node->boxes->GetMemoryUsage() : 0);
+        for (auto& child : node->children) {
+          bytes += NodeMemory(child.get());
+        }
+
+        return bytes;
+      }
+
+      static size_t NodeCount(const Node* node) {
+        if (node == nullptr) {
+          return 0;
+        }
+
+        size_t count = 1;
+        for (auto& child : node->children) {
+          count += NodeCount(child.get());
+        }
+
+        return count;
+      }
+
+      std::shared_ptr<const Node> root_;
+    };
+  }
+}
+
+#endif // CG_QUAD_TREE_INDEX_H_
@@ -0,0 +1,99 @@
+#ifndef CG_EDIT_JOURNAL_H_
+#define CG_EDIT_JOURNAL_H_
+
+#include "corrugate/MultiSampler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace cg {
+  // world rect whose samples may have changed
+  struct DirtyRect {
+    glm::dvec2 origin = glm::dvec2(0.0);
+    glm::dvec2 size = glm::dvec2(0.0);
+
+    glm::dvec2 GetEnd() const {
+      return origin + size;
+    }
+  };
+
+  /**
+   * @brief Records the world rects touched by box inserts / removes, until someone takes them.
+   *        A box's samples only change inside its footprint (falloff runs inside the box, and is 0 on the edge),
+   *        so each edit records that footprint - grown by margin, for consumers which filter across samples.
+   *        A moved box is a remove and an insert, so it dirties both its old and new footprints.
+   *
+   *        Thread safe.
+   */
+  class EditJournal {
+   public:
+    /**
+     * @param margin - world distance added to every side of each recorded rect
+     */
+    EditJournal(double margin = 0.0) : margin_(margin) {}
+
+    ~EditJournal() {
+      Detach();
+    }
+
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+
+    // records every insert / remove on sampler - sampler must outlive the attachment
+    template <typename BoxType>
+    void Attach(MultiSampler<BoxType>& sampler) {
+      Detach();
+      size_t id = sampler.AddEditListener([this](const glm::dvec2& origin, const glm::dvec2& size) {
+        Record(origin, size);
+      });
+
+      std::lock_guard<std::mutex> lock(lock_);
+      detach_ = [&sampler, id]() { sampler.RemoveEditListener(id); };
+    }
+
+    void Detach() {
+      std::function<void()> detach;
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        detach.swap(detach_);
+      }
+
+      if (detach) {
+        detach();
+      }
+    }
+
+    void Record(const glm::dvec2& origin, const glm::dvec2& size) {
+      DirtyRect rect;
+      rect.origin = origin - glm::dvec2(margin_);
+      rect.size = size + glm::dvec2(margin_ * 2.0);
+
+      std::lock_guard<std::mutex> lock(lock_);
+      rects_.push_back(rect);
+    }
+
+    // drains the journal
+    std::vector<DirtyRect> Take() {
+      std::vector<DirtyRect> res;
+      std::lock_guard<std::mutex> lock(lock_);
+      res.swap(rects_);
+      return res;
+    }
+
+    size_t size() const {
+      std::lock_guard<std::mutex> lock(lock_);
+      return rects_.size();
+    }
+
+   private:
+    double margin_;
+    std::vector<DirtyRect> rects_;
+    std::function<void()> detach_;
+    mutable std::mutex lock_;
+  };
+}
+
+#endif // CG_EDIT_JOURNAL_H_
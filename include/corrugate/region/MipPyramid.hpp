@@ -0,0 +1,331 @@
+#ifndef CG_MIP_PYRAMID_H_
+#define CG_MIP_PYRAMID_H_
+
+#include "corrugate/region/TileArchive.hpp"
+#include "corrugate/sampler/ChunkLayers.hpp"
+#include "corrugate/simd/Downsample.hpp"
+#include "corrugate/util/Workspace.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace cg {
+  enum MipFilter {
+    // 2x2 average
+    MIP_FILTER_BOX,
+    // separable 1 3 3 1 - a little softer than box, much less aliasing
+    MIP_FILTER_BINOMIAL
+  };
+
+  struct MipOptions {
+    MipFilter filter = MIP_FILTER_BOX;
+
+    // rescales every coarse sample's splat weights (across all planes) to sum to 1.
+    // only for splat layers which are pure blend weights - box falloff fades weights toward 0,
+    // and normalizing would inflate those edges. off, the filters already preserve weight totals
+    bool normalize_splat = false;
+  };
+
+  namespace impl {
+    // reduces one plane of channels floats per sample
+    inline void DownsamplePlane(const float* input, const glm::ivec2& input_dims, int channels, MipFilter filter, float* output, Workspace& ws) {
+      Workspace::Scope scope(ws);
+      int out_height = simd::GetReducedSize(input_dims.y);
+      size_t in_stride = static_cast<size_t>(input_dims.x) * channels;
+      size_t out_stride = static_cast<size_t>(simd::GetReducedSize(input_dims.x)) * channels;
+
+      // x-reduced rows, in a ring of 4 (binomial taps 4 rows, and the next output row reuses 2 of them) -
+      // each input row is read once, and the ring stays in cache
+      float* ring = ws.Allocate<float>(out_stride * 4);
+      int ring_rows[4] = { -1, -1, -1, -1 };
+      auto get_row = [&](int y) {
+        y = std::min(std::max(y, 0), input_dims.y - 1);
+        float* row = ring + (y & 3) * out_stride;
+        if (ring_rows[y & 3] != y) {
+          ring_rows[y & 3] = y;
+          if (filter == MIP_FILTER_BINOMIAL) {
+            simd::ReduceRowBinomial(input + y * in_stride, input_dims.x, channels, row);
+          } else {
+            simd::ReduceRowBox(input + y * in_stride, input_dims.x, channels, row);
+          }
+        }
+
+        return row;
+      };
+
+      int count = static_cast<int>(out_stride);
+      for (int y = 0; y < out_height; y++) {
+        if (filter == MIP_FILTER_BINOMIAL) {
+          // rows are fetched in order - a clamped row can't evict one still in use
+          const float* a = get_row(2 * y - 1);
+          const float* b = get_row(2 * y);
+          const float* c = get_row(2 * y + 1);
+          const float* d = get_row(2 * y + 2);
+          simd::ReduceColumnsBinomial(a, b, c, d, count, output + y * out_stride);
+        } else {
+          const float* a = get_row(2 * y);
+          const float* b = get_row(2 * y + 1);
+          simd::ReduceColumnsBox(a, b, count, output + y * out_stride);
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Reduces every layer in input by 2x along each axis.
+   *        Output sample (x, y) sits between input samples (2x, 2y) and (2x + 1, 2y + 1) - at twice the scale,
+   *        offset by half an input sample.
+   *
+   * @param input - input layers, each input_dims
+   * @param input_dims - input size, in samples
+   * @param output - output layers (same mask and splat range), each simd::GetReducedSize(input_dims)
+   * @param options - filter options
+   * @param workspace - scratch (thread-local workspace if null)
+   */
+  inline void DownsampleLayers(const ChunkLayers& input, const glm::ivec2& input_dims, const ChunkLayers& output, const MipOptions& options = MipOptions(), Workspace* workspace = nullptr) {
+    Workspace& ws = (workspace != nullptr ? *workspace : Workspace::Local());
+    glm::ivec2 output_dims(simd::GetReducedSize(input_dims.x), simd::GetReducedSize(input_dims.y));
+    size_t in_elems = static_cast<size_t>(input_dims.x) * input_dims.y;
+    size_t out_elems = static_cast<size_t>(output_dims.x) * output_dims.y;
+
+    if (input.Has(LAYER_HEIGHT)) {
+      impl::DownsamplePlane(input.height, input_dims, 1, options.filter, output.height, ws);
+    }
+
+    if (input.Has(LAYER_SPLAT)) {
+      for (size_t i = 0; i < input.splat_count; i++) {
+        const float* plane = reinterpret_cast<const float*>(input.splat + i * in_elems);
+        impl::DownsamplePlane(plane, input_dims, 4, options.filter, reinterpret_cast<float*>(output.splat + i * out_elems), ws);
+      }
+
+      if (options.normalize_splat) {
+        for (size_t s = 0; s < out_elems; s++) {
+          float total = 0.0f;
+          for (size_t i = 0; i < output.splat_count; i++) {
+            const glm::vec4& weights = output.splat[i * out_elems + s];
+            total += weights.x + weights.y + weights.z + weights.w;
+          }
+
+          if (total > 0.0f) {
+            float inv = 1.0f / total;
+            for (size_t i = 0; i < output.splat_count; i++) {
+              output.splat[i * out_elems + s] *= inv;
+            }
+          }
+        }
+      }
+    }
+
+    if (input.Has(LAYER_TREE_FILL)) {
+      impl::DownsamplePlane(input.tree_fill, input_dims, 1, options.filter, output.tree_fill, ws);
+    }
+  }
+
+  // one level of a pyramid - layers point into the level's own storage
+  struct MipLevel {
+    // world position of sample (0, 0)
+    glm::dvec2 origin = glm::dvec2(0.0);
+    glm::ivec2 dims = glm::ivec2(0);
+    double scale = 1.0;
+
+    ChunkLayers layers;
+
+    MipLevel() {}
+    MipLevel(MipLevel&&) = default;
+    MipLevel& operator=(MipLevel&&) = default;
+    MipLevel(const MipLevel&) = delete;
+    MipLevel& operator=(const MipLevel&) = delete;
+
+    // sizes storage for dims, and points layers at it
+    void Allocate(const ChunkLayers& request) {
+      size_t elems = static_cast<size_t>(dims.x) * dims.y;
+      layers = ChunkLayers();
+      layers.mask = request.mask;
+      layers.splat_first = request.splat_first;
+      layers.splat_count = request.splat_count;
+
+      if (layers.Has(LAYER_HEIGHT)) {
+        height_.resize(elems);
+        layers.height = height_.data();
+      }
+
+      if (layers.Has(LAYER_SPLAT)) {
+        splat_.resize(elems * layers.splat_count);
+        layers.splat = splat_.data();
+      }
+
+      if (layers.Has(LAYER_TREE_FILL)) {
+        tree_fill_.resize(elems);
+        layers.tree_fill = tree_fill_.data();
+      }
+    }
+
+   private:
+    std::vector<float> height_;
+    std::vector<glm::vec4> splat_;
+    std::vector<float> tree_fill_;
+  };
+
+  /**
+   * @brief LOD levels for a region: the finest level is written once, and every coarser level
+   *        is reduced from the one before it - instead of re-running the samplers at every scale
+   *        (which costs a full write per level, and aliases detail finer than the level's spacing).
+   */
+  class MipPyramid {
+   public:
+    MipPyramid() {}
+
+    MipPyramid(const MipPyramid&) = delete;
+    MipPyramid& operator=(const MipPyramid&) = delete;
+
+    /**
+     * @brief Writes level 0 from a sampler, then reduces it into the remaining levels.
+     *
+     * @param sampler - anything with WriteLayers(origin, dims, scale, layers, Workspace*) (e.g. MultiBoxSampler)
+     * @param origin - world origin of level 0
+     * @param dims - level 0 size, in samples
+     * @param scale - distance between level 0 samples
+     * @param request - layers to build (outputs are ignored)
+     * @param level_count - max levels, including level 0 (stops early once a level is 1x1)
+     * @param options - filter options
+     * @param workspace - scratch (thread-local workspace if null)
+     * @return size_t - bytes written to level 0 by the sampler, 0 on failure (pyramid is left empty)
+     */
+    template <typename SamplerType>
+    size_t Build(
+      const SamplerType& sampler,
+      const glm::dvec2& origin,
+      const glm::ivec2& dims,
+      double scale,
+      const ChunkLayers& request,
+      int level_count,
+      const MipOptions& options = MipOptions(),
+      Workspace* workspace = nullptr
+    ) {
+      levels_.clear();
+      if (level_count <= 0 || dims.x <= 0 || dims.y <= 0) {
+        return 0;
+      }
+
+      MipLevel base;
+      base.origin = origin;
+      base.dims = dims;
+      base.scale = scale;
+      base.Allocate(request);
+
+      size_t res = sampler.WriteLayers(origin, dims, scale, base.layers, workspace);
+      if (res != base.layers.GetByteCount(dims)) {
+        return 0;
+      }
+
+      levels_.push_back(std::move(base));
+      while (static_cast<int>(levels_.size()) < level_count && levels_.back().dims != glm::ivec2(1)) {
+        const MipLevel& prev = levels_.back();
+        MipLevel level;
+        level.origin = prev.origin + glm::dvec2(prev.scale * 0.5);
+        level.dims = glm::ivec2(simd::GetReducedSize(prev.dims.x), simd::GetReducedSize(prev.dims.y));
+        level.scale = prev.scale * 2.0;
+        level.Allocate(request);
+
+        DownsampleLayers(prev.layers, prev.dims, level.layers, options, workspace);
+        levels_.push_back(std::move(level));
+      }
+
+      return res;
+    }
+
+    size_t GetLevelCount() const {
+      return levels_.size();
+    }
+
+    const MipLevel& GetLevel(size_t level) const {
+      return levels_[level];
+    }
+
+    void Clear() {
+      levels_.clear();
+    }
+
+   private:
+    std::vector<MipLevel> levels_;
+  };
+
+  /**
+   * @brief Stores every level of a pyramid in an archive, cut into tiles (level n is stored as level n).
+   *        Tiles on the right / bottom edge of a level are cropped to the level.
+   *
+   * @param writer - open archive writer
+   * @param pyramid - built pyramid
+   * @param tile_size - tile edge, in samples
+   * @return size_t - number of tiles written, or 0 on a write error
+   */
+  inline size_t BakePyramidTiles(TileArchiveWriter& writer, const MipPyramid& pyramid, int tile_size) {
+    Workspace& ws = Workspace::Local();
+    Workspace::Scope scope(ws);
+    uint8_t* scratch = ws.Allocate<uint8_t>(static_cast<size_t>(tile_size) * tile_size * sizeof(glm::vec4));
+
+    size_t written = 0;
+    for (size_t l = 0; l < pyramid.GetLevelCount(); l++) {
+      const MipLevel& level = pyramid.GetLevel(l);
+      const ChunkLayers& layers = level.layers;
+      size_t elems = static_cast<size_t>(level.dims.x) * level.dims.y;
+      glm::ivec2 tile_count = (level.dims + glm::ivec2(tile_size - 1)) / tile_size;
+
+      for (int ty = 0; ty < tile_count.y; ty++) {
+        for (int tx = 0; tx < tile_count.x; tx++) {
+          glm::ivec2 begin = glm::ivec2(tx, ty) * tile_size;
+          glm::ivec2 dims = glm::min(level.dims - begin, glm::ivec2(tile_size));
+
+          TileArchiveKey key;
+          key.level = static_cast<uint32_t>(l);
+          key.tile = glm::ivec2(tx, ty);
+
+          // copies the tile's rows out of a plane, then stores them
+          auto write_plane = [&](const void* plane, size_t elem_size, TileFormat format) {
+            const uint8_t* src = static_cast<const uint8_t*>(plane);
+            size_t row_bytes = dims.x * elem_size;
+            for (int y = 0; y < dims.y; y++) {
+              size_t offset = (static_cast<size_t>(begin.y + y) * level.dims.x + begin.x) * elem_size;
+              memcpy(scratch + y * row_bytes, src + offset, row_bytes);
+            }
+
+            written++;
+            return writer.WriteTile(key, format, dims, scratch, row_bytes * dims.y);
+          };
+
+          bool ok = true;
+          if (layers.Has(LAYER_HEIGHT)) {
+            key.layer = LAYER_HEIGHT;
+            key.index = 0;
+            ok = ok && write_plane(layers.height, sizeof(float), TILE_R32F);
+          }
+
+          if (layers.Has(LAYER_SPLAT)) {
+            for (size_t i = 0; i < layers.splat_count; i++) {
+              key.layer = LAYER_SPLAT;
+              key.index = static_cast<uint32_t>(layers.splat_first + i);
+              ok = ok && write_plane(layers.splat + i * elems, sizeof(glm::vec4), TILE_RGBA32F);
+            }
+          }
+
+          if (layers.Has(LAYER_TREE_FILL)) {
+            key.layer = LAYER_TREE_FILL;
+            key.index = 0;
+            ok = ok && write_plane(layers.tree_fill, sizeof(float), TILE_R32F);
+          }
+
+          if (!ok) {
+            return 0;
+          }
+        }
+      }
+    }
+
+    return written;
+  }
+}
+
+#endif // CG_MIP_PYRAMID_H_
@@ -0,0 +1,313 @@
+#ifndef CG_REGION_GENERATOR_H_
+#define CG_REGION_GENERATOR_H_
+
+#include "corrugate/MultiSampler.hpp"
+#include "corrugate/region/EditJournal.hpp"
+#include "corrugate/sampler/MultiBoxSampler.hpp"
+#include "corrugate/sampler/SmoothingMultiBoxSampler.hpp"
+#include "corrugate/util/ThreadPool.hpp"
+#include "corrugate/util/Workspace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// default tile edge, in samples
+#define _REGION_TILE_SIZE 256
+
+namespace cg {
+  /**
+   * @brief Caller-owned outputs for a region. Layers left null are skipped.
+   *        Every buffer is row-major and covers the whole region (dims.x * dims.y samples).
+   */
+  struct RegionBuffers {
+    float* height = nullptr;
+
+    // base terrain under the region - only read when generating height w smoothing boxes
+    const float* underlying = nullptr;
+
+    // splat_count planes, one per index starting at splat_first
+    glm::vec4* splat = nullptr;
+    size_t splat_first = 0;
+    size_t splat_count = 0;
+
+    float* tree_fill = nullptr;
+  };
+
+  struct RegionStats {
+    size_t tiles = 0;
+    // sum of boxes fetched across tiles
+    size_t boxes = 0;
+    double seconds = 0.0;
+
+    double GetTilesPerSecond() const {
+      return (seconds > 0.0 ? tiles / seconds : 0.0);
+    }
+  };
+
+  /**
+   * @brief Splits a region into tiles and generates them on a thread pool.
+   *        Every tile fetches its boxes from the same snapshot, so a region is always
+   *        generated from one consistent version of the sampler.
+   */
+  template <typename BoxType>
+  class RegionGenerator {
+   public:
+    typedef typename MultiSampler<BoxType>::Snapshot snapshot_type;
+
+    RegionGenerator(const MultiSampler<BoxType>& sampler, ThreadPool& pool, int tile_size = _REGION_TILE_SIZE)
+    : sampler_(sampler), pool_(pool), tile_size_(std::max(tile_size, 1)) {}
+
+    /**
+     * @brief Generates every requested layer of a region.
+     *
+     * @param origin - global origin of the region
+     * @param dims - region size, in samples
+     * @param scale - distance between samples
+     * @param buffers - outputs
+     * @return RegionStats - tile count + timing
+     */
+    RegionStats Generate(const glm::dvec2& origin, const glm::ivec2& dims, double scale, const RegionBuffers& buffers) const {
+      auto start = std::chrono::steady_clock::now();
+      std::shared_ptr<const snapshot_type> snapshot = sampler_.GetSnapshot();
+
+      glm::ivec2 tile_count = GetTileCount(dims);
+      std::atomic<size_t> boxes(0);
+
+      pool_.ParallelFor(static_cast<size_t>(tile_count.x) * tile_count.y, [&](size_t tile) {
+        glm::ivec2 tile_coord(static_cast<int>(tile % tile_count.x), static_cast<int>(tile / tile_count.x));
+        boxes += GenerateTile(*snapshot, origin, dims, scale, tile_coord, buffers, Workspace::Local());
+      });
+
+      RegionStats stats;
+      stats.tiles = static_cast<size_t>(tile_count.x) * tile_count.y;
+      stats.boxes = boxes;
+      stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      return stats;
+    }
+
+    /**
+     * @brief Regenerates only the tiles of a region which overlap dirty rects.
+     *        Buffers must already hold the region (from Generate) - every other tile is left as is.
+     *        Cost scales with the dirty area, not the region.
+     *
+     * @param origin - global origin of the region
+     * @param dims - region size, in samples
+     * @param scale - distance between samples
+     * @param buffers - outputs, holding the previous generation
+     * @param dirty - changed world rects (see EditJournal)
+     * @return RegionStats - regenerated tile count + timing
+     */
+    RegionStats Regenerate(
+      const glm::dvec2& origin,
+      const glm::ivec2& dims,
+      double scale,
+      const RegionBuffers& buffers,
+      const std::vector<DirtyRect>& dirty
+    ) const {
+      auto start = std::chrono::steady_clock::now();
+      std::shared_ptr<const snapshot_type> snapshot = sampler_.GetSnapshot();
+
+      std::vector<glm::ivec2> tiles;
+      GetDirtyTiles(origin, dims, scale, dirty, tiles);
+      std::atomic<size_t> boxes(0);
+
+      pool_.ParallelFor(tiles.size(), [&](size_t i) {
+        boxes += GenerateTile(*snapshot, origin, dims, scale, tiles[i], buffers, Workspace::Local());
+      });
+
+      RegionStats stats;
+      stats.tiles = tiles.size();
+      stats.boxes = boxes;
+      stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      return stats;
+    }
+
+    // drains journal, then regenerates what it recorded
+    RegionStats Regenerate(const glm::dvec2& origin, const glm::ivec2& dims, double scale, const RegionBuffers& buffers, EditJournal& journal) const {
+      return Regenerate(origin, dims, scale, buffers, journal.Take());
+    }
+
+    /**
+     * @brief Lists the tiles of a region which have a sample inside (or on the edge of) any dirty rect, each once.
+     */
+    void GetDirtyTiles(
+      const glm::dvec2& origin,
+      const glm::ivec2& dims,
+      double scale,
+      const std::vector<DirtyRect>& dirty,
+      std::vector<glm::ivec2>& output
+    ) const {
+      glm::ivec2 tile_count = GetTileCount(dims);
+      std::vector<size_t> indices;
+      for (auto& rect : dirty) {
+        // samples sit at origin + i * scale - find the (closed) range of i inside the rect
+        glm::dvec2 first = glm::ceil((rect.origin - origin) / scale);
+        glm::dvec2 last = glm::floor((rect.GetEnd() - origin) / scale);
+        first = glm::max(first, glm::dvec2(0.0));
+        last = glm::min(last, glm::dvec2(dims - glm::ivec2(1)));
+        if (first.x > last.x || first.y > last.y) {
+          continue;
+        }
+
+        glm::ivec2 tile_begin = glm::ivec2(first) / tile_size_;
+        glm::ivec2 tile_end = glm::ivec2(last) / tile_size_;
+        for (int y = tile_begin.y; y <= tile_end.y; y++) {
+          for (int x = tile_begin.x; x <= tile_end.x; x++) {
+            indices.push_back(static_cast<size_t>(y) * tile_count.x + x);
+          }
+        }
+      }
+
+      std::sort(indices.begin(), indices.end());
+      indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+      output.clear();
+      for (size_t index : indices) {
+        output.push_back(glm::ivec2(static_cast<int>(index % tile_count.x), static_cast<int>(index / tile_count.x)));
+      }
+    }
+
+    glm::ivec2 GetTileCount(const glm::ivec2& dims) const {
+      return (dims + glm::ivec2(tile_size_ - 1)) / tile_size_;
+    }
+
+    int GetTileSize() const {
+      return tile_size_;
+    }
+
+    /**
+     * @brief Generates a single tile into the region buffers.
+     *
+     * @param tile - tile coordinate, in tiles from the region origin
+     * @return size_t - number of boxes which touched the tile
+     */
+    size_t GenerateTile(
+      const snapshot_type& snapshot,
+      const glm::dvec2& origin,
+      const glm::ivec2& dims,
+      double scale,
+      const glm::ivec2& tile,
+      const RegionBuffers& buffers,
+      Workspace& workspace
+    ) const {
+      glm::ivec2 tile_start = tile * tile_size_;
+      glm::ivec2 tile_dims = glm::min(glm::ivec2(tile_size_), dims - tile_start);
+      glm::dvec2 tile_origin = origin + glm::dvec2(tile_start) * scale;
+
+      // sample positions run from tile_origin to tile_origin + (tile_dims - 1) * scale
+      // - raw pointers are fine, the caller pins snapshot for the whole tile
+      std::vector<const BoxType*>& boxes = GetTileBoxes();
+      boxes.clear();
+      snapshot.ForEach(tile_origin, glm::dvec2(tile_dims - glm::ivec2(1)) * scale, [&](uint32_t, const std::shared_ptr<BoxType>& box) {
+        boxes.push_back(box.get());
+      });
+
+      MultiBoxSampler<BoxType> sampler(boxes.data(), boxes.size());
+      Workspace::Scope scope(workspace);
+
+      // falloff sum is shared by every layer of the tile
+      ChunkContext context(tile_origin, tile_dims, scale, workspace);
+      sampler.PrepareContext(context);
+
+      size_t tile_elems = static_cast<size_t>(tile_dims.x) * tile_dims.y;
+      size_t region_elems = static_cast<size_t>(dims.x) * dims.y;
+
+      // every layer of the tile in one pass
+      ChunkLayers layers;
+      if (buffers.height != nullptr) {
+        layers.mask |= LAYER_HEIGHT;
+        layers.height = workspace.Allocate<float>(tile_elems);
+      }
+
+      if (buffers.splat != nullptr && buffers.splat_count > 0) {
+        layers.mask |= LAYER_SPLAT;
+        layers.splat = workspace.Allocate<glm::vec4>(tile_elems * buffers.splat_count);
+        layers.splat_first = buffers.splat_first;
+        layers.splat_count = buffers.splat_count;
+      }
+
+      if (buffers.tree_fill != nullptr) {
+        layers.mask |= LAYER_TREE_FILL;
+        layers.tree_fill = workspace.Allocate<float>(tile_elems);
+      }
+
+      WriteTileLayers(boxes, sampler, context, tile_start, dims, buffers.underlying, layers);
+
+      if (layers.Has(LAYER_HEIGHT)) {
+        CopyTile(layers.height, tile_start, tile_dims, dims, buffers.height);
+      }
+
+      if (layers.Has(LAYER_SPLAT)) {
+        for (size_t i = 0; i < layers.splat_count; i++) {
+          CopyTile(layers.splat + i * tile_elems, tile_start, tile_dims, dims, buffers.splat + i * region_elems);
+        }
+      }
+
+      if (layers.Has(LAYER_TREE_FILL)) {
+        CopyTile(layers.tree_fill, tile_start, tile_dims, dims, buffers.tree_fill);
+      }
+
+      return boxes.size();
+    }
+
+   private:
+    const MultiSampler<BoxType>& sampler_;
+    ThreadPool& pool_;
+    int tile_size_;
+
+    // gathered boxes for the tile being generated - reused, so steady-state tiles don't allocate
+    // (GenerateTile never re-enters on a thread)
+    static std::vector<const BoxType*>& GetTileBoxes() {
+      thread_local std::vector<const BoxType*> boxes;
+      return boxes;
+    }
+
+    void WriteTileLayers(
+      const std::vector<const BoxType*>& boxes,
+      const MultiBoxSampler<BoxType>& sampler,
+      const ChunkContext& context,
+      const glm::ivec2& tile_start,
+      const glm::ivec2& dims,
+      const float* underlying,
+      const ChunkLayers& layers
+    ) const {
+      const glm::ivec2& tile_dims = context.sample_dims;
+      Workspace& workspace = context.GetWorkspace();
+
+      if constexpr (std::is_base_of_v<BaseSmoothingSamplerBox, BoxType>) {
+        if (underlying != nullptr && layers.Has(LAYER_HEIGHT)) {
+          Workspace::Scope scope(workspace);
+
+          // smoothing needs the base terrain under this tile, densely packed
+          float* tile_underlying = workspace.Allocate<float>(static_cast<size_t>(tile_dims.x) * tile_dims.y);
+          for (int y = 0; y < tile_dims.y; y++) {
+            const float* src = underlying + static_cast<size_t>(tile_start.y + y) * dims.x + tile_start.x;
+            std::copy(src, src + tile_dims.x, tile_underlying + static_cast<size_t>(y) * tile_dims.x);
+          }
+
+          SmoothingMultiBoxSampler<BoxType> smoothing(boxes.data(), boxes.size());
+          smoothing.WriteLayers(context, DataSampler<float>(tile_dims, tile_underlying), layers);
+          return;
+        }
+      }
+
+      sampler.WriteLayers(context, layers);
+    }
+
+    template <typename DataType>
+    static void CopyTile(const DataType* tile, const glm::ivec2& tile_start, const glm::ivec2& tile_dims, const glm::ivec2& dims, DataType* output) {
+      for (int y = 0; y < tile_dims.y; y++) {
+        const DataType* src = tile + static_cast<size_t>(y) * tile_dims.x;
+        std::copy(src, src + tile_dims.x, output + static_cast<size_t>(tile_start.y + y) * dims.x + tile_start.x);
+      }
+    }
+  };
+}
+
+#endif // CG_REGION_GENERATOR_H_
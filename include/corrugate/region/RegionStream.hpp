@@ -0,0 +1,297 @@
+#ifndef CG_REGION_STREAM_H_
+#define CG_REGION_STREAM_H_
+
+#include "corrugate/MultiSampler.hpp"
+#include "corrugate/region/RegionGenerator.hpp"
+#include "corrugate/sampler/ChunkLayers.hpp"
+#include "corrugate/sampler/MultiBoxSampler.hpp"
+#include "corrugate/util/ThreadPool.hpp"
+#include "corrugate/util/Workspace.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// default cap on block storage held by a stream
+#define _REGION_STREAM_BUDGET (64 * 1024 * 1024)
+
+namespace cg {
+  struct RegionStreamOptions {
+    // block size, in samples - a block wider than the region is a scanline band
+    glm::ivec2 block_dims = glm::ivec2(_REGION_TILE_SIZE);
+
+    // bytes of finished + in-flight blocks held at once (always room for at least one block)
+    size_t memory_budget = _REGION_STREAM_BUDGET;
+  };
+
+  // a generated block, in region row-major order
+  struct RegionBlock {
+    // block coordinate, in blocks
+    glm::ivec2 block = glm::ivec2(0);
+    // first sample, in region samples
+    glm::ivec2 start = glm::ivec2(0);
+    // block size, in samples (cropped on the right / bottom edge)
+    glm::ivec2 dims = glm::ivec2(0);
+    // world position of the first sample
+    glm::dvec2 origin = glm::dvec2(0.0);
+    // block outputs, each dims.x * dims.y samples - valid until the next call to Next
+    ChunkLayers layers;
+  };
+
+  /**
+   * @brief Pull-style generator for regions too big to hold: blocks come out in row-major order,
+   *        generated ahead on a thread pool into a fixed ring of slots.
+   *        A slot is only refilled once the consumer moves past its block, so producers never run more
+   *        than a budget's worth of blocks ahead - memory depends on block size and budget, not on region size.
+   *
+   *        Consume from one thread, and not from one of pool's workers (the consumer blocks while it waits).
+   */
+  class RegionStream {
+   public:
+    // fills every output of layers for a block - called on pool threads, concurrently for different blocks
+    typedef std::function<void(const glm::dvec2& origin, const glm::ivec2& dims, double scale, const ChunkLayers& layers, Workspace& workspace)> block_writer;
+
+    /**
+     * @param writer - block writer
+     * @param pool - pool to generate on
+     * @param origin - global origin of the region
+     * @param dims - region size, in samples
+     * @param scale - distance between samples
+     * @param request - layers to generate (outputs are ignored)
+     * @param options - block size + budget
+     */
+    RegionStream(
+      block_writer writer,
+      ThreadPool& pool,
+      const glm::dvec2& origin,
+      const glm::ivec2& dims,
+      double scale,
+      const ChunkLayers& request,
+      const RegionStreamOptions& options = RegionStreamOptions()
+    ) : writer_(std::move(writer)), pool_(pool), origin_(origin), dims_(glm::max(dims, glm::ivec2(0))), scale_(scale) {
+      request_ = ChunkLayers();
+      request_.mask = request.mask;
+      request_.splat_first = request.splat_first;
+      request_.splat_count = (request.Has(LAYER_SPLAT) ? request.splat_count : 0);
+
+      block_dims_ = glm::clamp(options.block_dims, glm::ivec2(1), glm::max(dims_, glm::ivec2(1)));
+      block_count_ = (dims_ + block_dims_ - glm::ivec2(1)) / block_dims_;
+
+      size_t blocks = GetBlockCount();
+      size_t block_bytes = std::max(request_.GetByteCount(block_dims_), static_cast<size_t>(1));
+      size_t slot_count = std::min(std::max(options.memory_budget / block_bytes, static_cast<size_t>(1)), std::max(blocks, static_cast<size_t>(1)));
+
+      slots_.resize(slot_count);
+      size_t block_elems = static_cast<size_t>(block_dims_.x) * block_dims_.y;
+      for (auto& slot : slots_) {
+        slot.height.resize(request_.Has(LAYER_HEIGHT) ? block_elems : 0);
+        slot.splat.resize(block_elems * request_.splat_count);
+        slot.tree_fill.resize(request_.Has(LAYER_TREE_FILL) ? block_elems : 0);
+      }
+    }
+
+    ~RegionStream() {
+      std::unique_lock<std::mutex> lock(lock_);
+      cancelled_ = true;
+      cv_.wait(lock, [this]() { return in_flight_ == 0; });
+    }
+
+    RegionStream(const RegionStream&) = delete;
+    RegionStream& operator=(const RegionStream&) = delete;
+
+    /**
+     * @brief Waits for the next block. Hands the previous block's slot back to the producers.
+     * @return false once every block has been returned
+     */
+    bool Next(RegionBlock& output) {
+      std::vector<size_t> submit;
+      std::unique_lock<std::mutex> lock(lock_);
+      if (!started_) {
+        started_ = true;
+        start_ = std::chrono::steady_clock::now();
+        while (next_submit_ < std::min(slots_.size(), GetBlockCount())) {
+          submit.push_back(next_submit_++);
+        }
+      } else if (holding_) {
+        holding_ = false;
+        if (next_submit_ < GetBlockCount()) {
+          submit.push_back(next_submit_++);
+        }
+      }
+
+      in_flight_ += submit.size();
+      lock.unlock();
+      for (size_t block : submit) {
+        pool_.Submit([this, block]() { Produce(block); });
+      }
+
+      lock.lock();
+      if (next_consume_ >= GetBlockCount()) {
+        return false;
+      }
+
+      Slot& slot = slots_[next_consume_ % slots_.size()];
+      cv_.wait(lock, [&]() { return slot.ready; });
+      slot.ready = false;
+      holding_ = true;
+
+      output.block = GetBlockCoord(next_consume_);
+      output.start = output.block * block_dims_;
+      output.dims = GetBlockDims(output.start);
+      output.origin = origin_ + glm::dvec2(output.start) * scale_;
+      output.layers = GetSlotLayers(slot);
+      next_consume_++;
+      return true;
+    }
+
+    size_t GetBlockCount() const {
+      return static_cast<size_t>(block_count_.x) * block_count_.y;
+    }
+
+    glm::ivec2 GetBlockDims() const {
+      return block_dims_;
+    }
+
+    // blocks which can be held at once
+    size_t GetSlotCount() const {
+      return slots_.size();
+    }
+
+    // bytes of block storage - fixed for the life of the stream
+    size_t GetMemoryUsage() const {
+      return slots_.size() * request_.GetByteCount(block_dims_);
+    }
+
+    // blocks handed out so far, and time since the first Next
+    RegionStats GetStats() const {
+      std::lock_guard<std::mutex> lock(lock_);
+      RegionStats stats;
+      stats.tiles = next_consume_;
+      if (started_) {
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+      }
+
+      return stats;
+    }
+
+    /**
+     * @brief Generates blocks from a sampler's current snapshot, tile by tile (as RegionGenerator does).
+     *        Edits made while streaming don't show up - the whole region comes from one version of the sampler.
+     *        Smoothing is left out: there's no region-sized underlying terrain to smooth toward.
+     */
+    template <typename BoxType>
+    static block_writer GetWriter(const MultiSampler<BoxType>& sampler, ThreadPool& pool, int tile_size = _REGION_TILE_SIZE) {
+      std::shared_ptr<const typename MultiSampler<BoxType>::Snapshot> snapshot = sampler.GetSnapshot();
+      RegionGenerator<BoxType> generator(sampler, pool, tile_size);
+      return [snapshot, generator, &pool](const glm::dvec2& origin, const glm::ivec2& dims, double scale, const ChunkLayers& layers, Workspace& workspace) {
+        RegionBuffers buffers;
+        buffers.height = layers.height;
+        buffers.splat = layers.splat;
+        buffers.splat_first = layers.splat_first;
+        buffers.splat_count = layers.splat_count;
+        buffers.tree_fill = layers.tree_fill;
+
+        glm::ivec2 tile_count = generator.GetTileCount(dims);
+        if (tile_count == glm::ivec2(1)) {
+          generator.GenerateTile(*snapshot, origin, dims, scale, glm::ivec2(0), buffers, workspace);
+          return;
+        }
+
+        // bands span several tiles - spread them out (ParallelFor helps from inside a task)
+        pool.ParallelFor(static_cast<size_t>(tile_count.x) * tile_count.y, [&](size_t tile) {
+          glm::ivec2 tile_coord(static_cast<int>(tile % tile_count.x), static_cast<int>(tile / tile_count.x));
+          generator.GenerateTile(*snapshot, origin, dims, scale, tile_coord, buffers, Workspace::Local());
+        });
+      };
+    }
+
+    // generates blocks from a fixed set of boxes (sampler must outlive the stream)
+    template <typename BoxType>
+    static block_writer GetWriter(const MultiBoxSampler<BoxType>& sampler) {
+      return [&sampler](const glm::dvec2& origin, const glm::ivec2& dims, double scale, const ChunkLayers& layers, Workspace& workspace) {
+        sampler.WriteLayers(origin, dims, scale, layers, &workspace);
+      };
+    }
+
+   private:
+    struct Slot {
+      std::vector<float> height;
+      std::vector<glm::vec4> splat;
+      std::vector<float> tree_fill;
+      bool ready = false;
+    };
+
+    glm::ivec2 GetBlockCoord(size_t block) const {
+      return glm::ivec2(static_cast<int>(block % block_count_.x), static_cast<int>(block / block_count_.x));
+    }
+
+    glm::ivec2 GetBlockDims(const glm::ivec2& start) const {
+      return glm::min(block_dims_, dims_ - start);
+    }
+
+    // layers point at the front of the slot, packed for the block's (possibly cropped) dims
+    ChunkLayers GetSlotLayers(Slot& slot) const {
+      ChunkLayers layers = request_;
+      layers.height = (layers.Has(LAYER_HEIGHT) ? slot.height.data() : nullptr);
+      layers.splat = (layers.splat_count > 0 ? slot.splat.data() : nullptr);
+      layers.tree_fill = (layers.Has(LAYER_TREE_FILL) ? slot.tree_fill.data() : nullptr);
+      return layers;
+    }
+
+    void Produce(size_t block) {
+      // slot is ours until it's marked ready - the consumer can't get to it before then
+      Slot& slot = slots_[block % slots_.size()];
+      bool cancelled;
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        cancelled = cancelled_;
+      }
+
+      if (!cancelled) {
+        glm::ivec2 start = GetBlockCoord(block) * block_dims_;
+        Workspace& workspace = Workspace::Local();
+        Workspace::Scope scope(workspace);
+        writer_(origin_ + glm::dvec2(start) * scale_, GetBlockDims(start), scale_, GetSlotLayers(slot), workspace);
+      }
+
+      std::lock_guard<std::mutex> lock(lock_);
+      slot.ready = true;
+      in_flight_--;
+      cv_.notify_all();
+    }
+
+    block_writer writer_;
+    ThreadPool& pool_;
+
+    glm::dvec2 origin_;
+    glm::ivec2 dims_;
+    double scale_;
+    ChunkLayers request_;
+
+    glm::ivec2 block_dims_;
+    glm::ivec2 block_count_;
+
+    // ring of block storage - block i lives in slot i % size
+    std::vector<Slot> slots_;
+
+    size_t next_submit_ = 0;
+    size_t next_consume_ = 0;
+    size_t in_flight_ = 0;
+    // consumer holds the last block returned
+    bool holding_ = false;
+    bool started_ = false;
+    bool cancelled_ = false;
+    std::chrono::steady_clock::time_point start_;
+
+    mutable std::mutex lock_;
+    std::condition_variable cv_;
+  };
+}
+
+#endif // CG_REGION_STREAM_H_
@@ -0,0 +1,579 @@
+#ifndef CG_TILE_ARCHIVE_H_
+#define CG_TILE_ARCHIVE_H_
+
+#include "corrugate/sampler/ChunkLayers.hpp"
+#include "corrugate/util/TempFile.hpp"
+#include "corrugate/util/Workspace.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define _TILE_ARCHIVE_MMAP 1
+#else
+#define _TILE_ARCHIVE_MMAP 0
+#endif
+
+// "CGTA"
+#define _TILE_ARCHIVE_MAGIC 0x41544743U
+#define _TILE_ARCHIVE_VERSION 1U
+// payload alignment - keeps tiles friendly to simd loads straight out of the mapping
+#define _TILE_ARCHIVE_ALIGNMENT 64
+
+// file layout:
+// - header (64 bytes)
+// - tile payloads, each starting on a _TILE_ARCHIVE_ALIGNMENT boundary
+// - index: header.count entries, sorted by key (layer, index, level, y, x)
+// payloads are streamed as they're written - the index goes last, and the header is patched on Finish
+
+namespace cg {
+  // element format of a tile payload
+  enum TileFormat : uint32_t {
+    TILE_R32F,
+    TILE_RGBA32F,
+    TILE_R16_UNORM,
+    TILE_R16F,
+    TILE_RGBA8,
+    TILE_R8
+  };
+
+  inline size_t GetTileFormatSize(TileFormat format) {
+    switch (format) {
+      case TILE_R32F:
+        return 4;
+      case TILE_RGBA32F:
+        return 16;
+      case TILE_R16_UNORM:
+      case TILE_R16F:
+        return 2;
+      case TILE_RGBA8:
+        return 4;
+      case TILE_R8:
+        return 1;
+    }
+
+    return 0;
+  }
+
+  struct TileArchiveKey {
+    // LayerMask bit
+    uint32_t layer = 0;
+    // splat index (0 for other layers)
+    uint32_t index = 0;
+    // mip level
+    uint32_t level = 0;
+    glm::ivec2 tile = glm::ivec2(0);
+
+    bool operator<(const TileArchiveKey& other) const {
+      return std::make_tuple(layer, index, level, tile.y, tile.x) < std::make_tuple(other.layer, other.index, other.level, other.tile.y, other.tile.x);
+    }
+
+    bool operator==(const TileArchiveKey& other) const {
+      return layer == other.layer && index == other.index && level == other.level && tile == other.tile;
+    }
+  };
+
+  // on-disk index entry
+  struct TileArchiveEntry {
+    uint32_t layer;
+    uint32_t index;
+    uint32_t level;
+    int32_t tile_x;
+    int32_t tile_y;
+    uint32_t format;
+    int32_t dims_x;
+    int32_t dims_y;
+    uint64_t offset;
+    uint64_t bytes;
+
+    TileArchiveKey GetKey() const {
+      TileArchiveKey key;
+      key.layer = layer;
+      key.index = index;
+      key.level = level;
+      key.tile = glm::ivec2(tile_x, tile_y);
+      return key;
+    }
+
+    glm::ivec2 GetDims() const {
+      return glm::ivec2(dims_x, dims_y);
+    }
+  };
+
+  namespace impl {
+    struct TileArchiveHeader {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t alignment;
+      uint32_t tile_size;
+      uint64_t count;
+      uint64_t index_offset;
+      double scale;
+      double origin_x;
+      double origin_y;
+      uint64_t reserved;
+    };
+
+    static_assert(sizeof(TileArchiveHeader) == 64);
+  }
+
+  /**
+   * @brief Streams tiles into an archive. Tiles can be written in any order, each key once.
+   *        Writes to a temp file of its own (see OpenTempFile), and only replaces path on Finish -
+   *        an unfinished archive never shows up, and concurrent bakers of one path don't write over each other.
+   */
+  class TileArchiveWriter {
+   public:
+    TileArchiveWriter() {}
+    ~TileArchiveWriter() {
+      Abort();
+    }
+
+    TileArchiveWriter(const TileArchiveWriter&) = delete;
+    TileArchiveWriter& operator=(const TileArchiveWriter&) = delete;
+
+    /**
+     * @param path - archive path
+     * @param origin - world origin of tile (0, 0) at level 0 (informational, for readers)
+     * @param tile_size - nominal tile edge, in samples (edge tiles may be smaller)
+     * @param scale - distance between samples at level 0
+     * @return false if the file couldn't be created
+     */
+    bool Open(const std::string& path, const glm::dvec2& origin, int tile_size, double scale) {
+      Abort();
+      path_ = path;
+      file_ = OpenTempFile(path, temp_path_);
+      if (file_ == nullptr) {
+        return false;
+      }
+
+      header_ = impl::TileArchiveHeader {};
+      header_.magic = _TILE_ARCHIVE_MAGIC;
+      header_.version = _TILE_ARCHIVE_VERSION;
+      header_.alignment = _TILE_ARCHIVE_ALIGNMENT;
+      header_.tile_size = static_cast<uint32_t>(tile_size);
+      header_.scale = scale;
+      header_.origin_x = origin.x;
+      header_.origin_y = origin.y;
+
+      // placeholder - patched on Finish
+      entries_.clear();
+      offset_ = 0;
+      if (!Append(&header_, sizeof(header_))) {
+        Abort();
+        return false;
+      }
+
+      return true;
+    }
+
+    /**
+     * @brief Appends a tile payload.
+     * @return false on a write error, a duplicate key, or a size mismatch
+     */
+    bool WriteTile(const TileArchiveKey& key, TileFormat format, const glm::ivec2& dims, const void* data, size_t n_bytes) {
+      if (file_ == nullptr || n_bytes != static_cast<size_t>(dims.x) * dims.y * GetTileFormatSize(format)) {
+        return false;
+      }
+
+      if (!Pad()) {
+        return false;
+      }
+
+      TileArchiveEntry entry;
+      entry.layer = key.layer;
+      entry.index = key.index;
+      entry.level = key.level;
+      entry.tile_x = key.tile.x;
+      entry.tile_y = key.tile.y;
+      entry.format = format;
+      entry.dims_x = dims.x;
+      entry.dims_y = dims.y;
+      entry.offset = offset_;
+      entry.bytes = n_bytes;
+
+      if (!Append(data, n_bytes)) {
+        return false;
+      }
+
+      entries_.push_back(entry);
+      return true;
+    }
+
+    /**
+     * @brief Writes the index, patches the header and moves the archive into place.
+     * @return false if anything failed (the archive is discarded)
+     */
+    bool Finish() {
+      if (file_ == nullptr) {
+        return false;
+      }
+
+      std::sort(entries_.begin(), entries_.end(), [](const TileArchiveEntry& a, const TileArchiveEntry& b) {
+        return a.GetKey() < b.GetKey();
+      });
+
+      bool ok = true;
+      for (size_t i = 1; i < entries_.size(); i++) {
+        ok = ok && !(entries_[i - 1].GetKey() == entries_[i].GetKey());
+      }
+
+      ok = ok && Pad();
+      header_.count = entries_.size();
+      header_.index_offset = offset_;
+      ok = ok && (entries_.empty() || Append(entries_.data(), entries_.size() * sizeof(TileArchiveEntry)));
+      ok = ok && fseek(file_, 0, SEEK_SET) == 0 && fwrite(&header_, sizeof(header_), 1, file_) == 1;
+      ok = (fclose(file_) == 0) && ok;
+      file_ = nullptr;
+
+      if (!ok || std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        std::remove(temp_path_.c_str());
+        return false;
+      }
+
+      entries_.clear();
+      return true;
+    }
+
+    // drops an unfinished archive
+    void Abort() {
+      if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+        std::remove(temp_path_.c_str());
+      }
+
+      entries_.clear();
+    }
+
+    size_t GetTileCount() const {
+      return entries_.size();
+    }
+
+   private:
+    bool Append(const void* data, size_t n_bytes) {
+      if (fwrite(data, 1, n_bytes, file_) != n_bytes) {
+        return false;
+      }
+
+      offset_ += n_bytes;
+      return true;
+    }
+
+    bool Pad() {
+      static const uint8_t zeroes[_TILE_ARCHIVE_ALIGNMENT] = {};
+      size_t pad = (_TILE_ARCHIVE_ALIGNMENT - offset_ % _TILE_ARCHIVE_ALIGNMENT) % _TILE_ARCHIVE_ALIGNMENT;
+      return pad == 0 || Append(zeroes, pad);
+    }
+
+    std::string path_;
+    std::string temp_path_;
+    FILE* file_ = nullptr;
+    uint64_t offset_ = 0;
+    impl::TileArchiveHeader header_ {};
+    std::vector<TileArchiveEntry> entries_;
+  };
+
+  /**
+   * @brief Read-only view of an archive, mapped into memory - tiles point straight into the mapping.
+   *        Opening only validates the header and index, so startup doesn't depend on archive size.
+   *        Safe to read from any number of threads.
+   */
+  class TileArchive {
+   public:
+    TileArchive() {}
+    ~TileArchive() {
+      Close();
+    }
+
+    TileArchive(const TileArchive&) = delete;
+    TileArchive& operator=(const TileArchive&) = delete;
+
+    /**
+     * @return false if the file is missing, not an archive, from another version, or malformed
+     */
+    bool Open(const std::string& path) {
+      Close();
+      if (!Map(path)) {
+        return false;
+      }
+
+      impl::TileArchiveHeader header;
+      bool ok = size_ >= sizeof(header);
+      if (ok) {
+        memcpy(&header, data_, sizeof(header));
+        ok = header.magic == _TILE_ARCHIVE_MAGIC
+          && header.version == _TILE_ARCHIVE_VERSION
+          && header.alignment == _TILE_ARCHIVE_ALIGNMENT
+          && header.index_offset % alignof(TileArchiveEntry) == 0
+          && header.index_offset <= size_
+          && header.count <= (size_ - header.index_offset) / sizeof(TileArchiveEntry);
+      }
+
+      if (ok) {
+        entries_ = reinterpret_cast<const TileArchiveEntry*>(data_ + header.index_offset);
+        count_ = header.count;
+        for (size_t i = 0; ok && i < count_; i++) {
+          const TileArchiveEntry& entry = entries_[i];
+          TileFormat format = static_cast<TileFormat>(entry.format);
+          ok = entry.offset % _TILE_ARCHIVE_ALIGNMENT == 0
+            && entry.offset <= header.index_offset
+            && entry.bytes <= header.index_offset - entry.offset
+            && entry.dims_x >= 0 && entry.dims_y >= 0
+            && entry.bytes == static_cast<uint64_t>(entry.dims_x) * entry.dims_y * GetTileFormatSize(format)
+            && (i == 0 || entries_[i - 1].GetKey() < entry.GetKey());
+        }
+      }
+
+      if (!ok) {
+        Close();
+        return false;
+      }
+
+      header_ = header;
+      return true;
+    }
+
+    void Close() {
+      Unmap();
+      entries_ = nullptr;
+      count_ = 0;
+    }
+
+    bool IsOpen() const {
+      return data_ != nullptr;
+    }
+
+    // null if there's no such tile
+    const TileArchiveEntry* Find(const TileArchiveKey& key) const {
+      const TileArchiveEntry* end = entries_ + count_;
+      const TileArchiveEntry* itr = std::lower_bound(entries_, end, key, [](const TileArchiveEntry& entry, const TileArchiveKey& key) {
+        return entry.GetKey() < key;
+      });
+
+      return (itr != end && itr->GetKey() == key ? itr : nullptr);
+    }
+
+    // payload of an entry, in the mapping
+    const void* GetData(const TileArchiveEntry& entry) const {
+      return data_ + entry.offset;
+    }
+
+    // null if there's no such tile
+    const void* GetTile(const TileArchiveKey& key) const {
+      const TileArchiveEntry* entry = Find(key);
+      return (entry != nullptr ? GetData(*entry) : nullptr);
+    }
+
+    size_t GetTileCount() const {
+      return count_;
+    }
+
+    const TileArchiveEntry* begin() const {
+      return entries_;
+    }
+
+    const TileArchiveEntry* end() const {
+      return entries_ + count_;
+    }
+
+    int GetTileSize() const {
+      return static_cast<int>(header_.tile_size);
+    }
+
+    double GetScale() const {
+      return header_.scale;
+    }
+
+    glm::dvec2 GetOrigin() const {
+      return glm::dvec2(header_.origin_x, header_.origin_y);
+    }
+
+   private:
+#if _TILE_ARCHIVE_MMAP
+    bool Map(const std::string& path) {
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        return false;
+      }
+
+      struct stat info;
+      if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+      }
+
+      void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+      if (mapping == MAP_FAILED) {
+        return false;
+      }
+
+      data_ = static_cast<const uint8_t*>(mapping);
+      size_ = static_cast<size_t>(info.st_size);
+      return true;
+    }
+
+    void Unmap() {
+      if (data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+      }
+
+      data_ = nullptr;
+      size_ = 0;
+    }
+#else
+    // no mmap - read the whole file (aligned, so payloads keep their alignment)
+    bool Map(const std::string& path) {
+      FILE* file = fopen(path.c_str(), "rb");
+      if (file == nullptr) {
+        return false;
+      }
+
+      fseek(file, 0, SEEK_END);
+      long length = ftell(file);
+      fseek(file, 0, SEEK_SET);
+      if (length <= 0) {
+        fclose(file);
+        return false;
+      }
+
+      buffer_.resize((static_cast<size_t>(length) + _TILE_ARCHIVE_ALIGNMENT - 1) / _TILE_ARCHIVE_ALIGNMENT);
+      bool ok = fread(buffer_.data(), 1, static_cast<size_t>(length), file) == static_cast<size_t>(length);
+      fclose(file);
+      if (!ok) {
+        buffer_.clear();
+        return false;
+      }
+
+      data_ = reinterpret_cast<const uint8_t*>(buffer_.data());
+      size_ = static_cast<size_t>(length);
+      return true;
+    }
+
+    void Unmap() {
+      buffer_.clear();
+      data_ = nullptr;
+      size_ = 0;
+    }
+
+    struct alignas(_TILE_ARCHIVE_ALIGNMENT) Block {
+      uint8_t bytes[_TILE_ARCHIVE_ALIGNMENT];
+    };
+
+    std::vector<Block> buffer_;
+#endif
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    const TileArchiveEntry* entries_ = nullptr;
+    size_t count_ = 0;
+    impl::TileArchiveHeader header_ {};
+  };
+
+  /**
+   * @brief Bakes a grid of tiles into an archive, one layer write per tile.
+   *        Each layer plane (each splat index) becomes its own tile.
+   *
+   * @param writer - open archive writer
+   * @param sampler - anything with WriteLayers(origin, dims, scale, layers, Workspace*) (e.g. MultiBoxSampler)
+   * @param origin - world origin of tile (0, 0)
+   * @param tile_count - tiles along x / y
+   * @param tile_size - tile edge, in samples
+   * @param scale - distance between samples
+   * @param level - level to store the tiles at
+   * @param request - layers to bake (ChunkLayers or QuantizedChunkLayers - outputs are ignored)
+   * @return size_t - number of tiles written, or 0 on a write error
+   */
+  template <typename SamplerType, typename LayersType>
+  size_t BakeTiles(
+    TileArchiveWriter& writer,
+    const SamplerType& sampler,
+    const glm::dvec2& origin,
+    const glm::ivec2& tile_count,
+    int tile_size,
+    double scale,
+    uint32_t level,
+    const LayersType& request
+  ) {
+    constexpr bool quantized = std::is_same_v<LayersType, QuantizedChunkLayers>;
+    TileFormat height_format = TILE_R32F;
+    if constexpr (quantized) {
+      height_format = (request.height_format == HEIGHT_R16F ? TILE_R16F : TILE_R16_UNORM);
+    }
+
+    TileFormat splat_format = (quantized ? TILE_RGBA8 : TILE_RGBA32F);
+    TileFormat fill_format = (quantized ? TILE_R8 : TILE_R32F);
+
+    glm::ivec2 dims(tile_size);
+    size_t elems = static_cast<size_t>(tile_size) * tile_size;
+
+    Workspace& ws = Workspace::Local();
+    Workspace::Scope scope(ws);
+
+    // one tile's worth of every requested layer, reused across tiles
+    LayersType layers = request;
+    layers.height = (request.Has(LAYER_HEIGHT) ? ws.Allocate<std::remove_pointer_t<decltype(layers.height)>>(elems) : nullptr);
+    layers.splat = (request.Has(LAYER_SPLAT) ? ws.Allocate<std::remove_pointer_t<decltype(layers.splat)>>(elems * request.splat_count * (quantized ? 4 : 1)) : nullptr);
+    layers.tree_fill = (request.Has(LAYER_TREE_FILL) ? ws.Allocate<std::remove_pointer_t<decltype(layers.tree_fill)>>(elems) : nullptr);
+
+    size_t written = 0;
+    for (int y = 0; y < tile_count.y; y++) {
+      for (int x = 0; x < tile_count.x; x++) {
+        glm::dvec2 tile_origin = origin + glm::dvec2(x, y) * (static_cast<double>(tile_size) * scale);
+        if (sampler.WriteLayers(tile_origin, dims, scale, layers, &ws) != layers.GetByteCount(dims)) {
+          return 0;
+        }
+
+        TileArchiveKey key;
+        key.level = level;
+        key.tile = glm::ivec2(x, y);
+
+        bool ok = true;
+        if (layers.Has(LAYER_HEIGHT)) {
+          key.layer = LAYER_HEIGHT;
+          key.index = 0;
+          ok = ok && writer.WriteTile(key, height_format, dims, layers.height, elems * GetTileFormatSize(height_format));
+          written++;
+        }
+
+        if (layers.Has(LAYER_SPLAT)) {
+          size_t plane_bytes = elems * GetTileFormatSize(splat_format);
+          for (size_t i = 0; i < layers.splat_count; i++) {
+            key.layer = LAYER_SPLAT;
+            key.index = static_cast<uint32_t>(layers.splat_first + i);
+            ok = ok && writer.WriteTile(key, splat_format, dims, reinterpret_cast<const uint8_t*>(layers.splat) + i * plane_bytes, plane_bytes);
+            written++;
+          }
+        }
+
+        if (layers.Has(LAYER_TREE_FILL)) {
+          key.layer = LAYER_TREE_FILL;
+          key.index = 0;
+          ok = ok && writer.WriteTile(key, fill_format, dims, layers.tree_fill, elems * GetTileFormatSize(fill_format));
+          written++;
+        }
+
+        if (!ok) {
+          return 0;
+        }
+      }
+    }
+
+    return written;
+  }
+}
+
+#endif // CG_TILE_ARCHIVE_H_
@@ -0,0 +1,345 @@
+#ifndef CG_TILE_CACHE_H_
+#define CG_TILE_CACHE_H_
+
+#include "corrugate/MultiSampler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// world size of the cells used to find tiles hit by an edit
+#define _TILE_CACHE_CELL_SIZE 256.0
+
+namespace cg {
+  // identifies a written tile - same arguments as a chunk write
+  struct TileKey {
+    glm::dvec2 origin = glm::dvec2(0.0);
+    glm::ivec2 dims = glm::ivec2(0);
+    double scale = 1.0;
+    // LayerMask bit
+    uint32_t layer = 0;
+    // splat index, or anything else which tells variants of a layer apart (quantized formats etc.)
+    uint64_t index = 0;
+
+    bool operator==(const TileKey& other) const {
+      return origin == other.origin && dims == other.dims && scale == other.scale && layer == other.layer && index == other.index;
+    }
+  };
+
+  struct TileCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // dropped to stay under budget
+    uint64_t evictions = 0;
+    // dropped because an edit touched them
+    uint64_t invalidations = 0;
+    size_t bytes = 0;
+    size_t entries = 0;
+  };
+
+  /**
+   * @brief LRU cache of written tiles, bounded by a byte budget.
+   *        Attach it to a MultiSampler and every box insert / remove drops the tiles under that box -
+   *        edits are matched to tiles through a coarse cell grid, then by exact rect.
+   *
+   *        Thread safe. Tiles are handed out as shared pointers, so a tile stays valid for its reader
+   *        even if it's evicted meanwhile.
+   */
+  class TileCache {
+   public:
+    typedef std::vector<uint8_t> tile_type;
+
+    TileCache(size_t byte_budget) : budget_(byte_budget) {}
+
+    ~TileCache() {
+      Detach();
+    }
+
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+
+    /**
+     * @brief Invalidates tiles whenever a box is inserted into / removed from sampler.
+     *        Sampler must outlive the attachment (see Detach).
+     */
+    template <typename BoxType>
+    void Attach(MultiSampler<BoxType>& sampler) {
+      Detach();
+      size_t id = sampler.AddEditListener([this](const glm::dvec2& origin, const glm::dvec2& size) {
+        Invalidate(origin, size);
+      });
+
+      std::lock_guard<std::mutex> lock(lock_);
+      detach_ = [&sampler, id]() { sampler.RemoveEditListener(id); };
+    }
+
+    void Detach() {
+      std::function<void()> detach;
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        detach.swap(detach_);
+      }
+
+      if (detach) {
+        detach();
+      }
+    }
+
+    // null on a miss
+    std::shared_ptr<const tile_type> Find(const TileKey& key) {
+      std::lock_guard<std::mutex> lock(lock_);
+      auto itr = entries_.find(key);
+      if (itr == entries_.end()) {
+        stats_.misses++;
+        return nullptr;
+      }
+
+      stats_.hits++;
+      lru_.splice(lru_.begin(), lru_, itr->second);
+      return itr->second->data;
+    }
+
+    /**
+     * @brief Caches a tile (replacing any tile with the same key), evicting old tiles to stay in budget.
+     *        Tiles larger than the whole budget aren't kept.
+     *
+     * @param key - tile key
+     * @param data - tile contents
+     * @param edit_epoch - GetEditEpoch() from before the tile was written - if an edit has landed since,
+     *                     the tile might be stale and isn't kept
+     */
+    std::shared_ptr<const tile_type> Insert(const TileKey& key, tile_type&& data, uint64_t edit_epoch) {
+      auto tile = std::make_shared<const tile_type>(std::move(data));
+
+      std::lock_guard<std::mutex> lock(lock_);
+      if (edit_epoch != edit_epoch_ || tile->size() > budget_) {
+        return tile;
+      }
+
+      auto itr = entries_.find(key);
+      if (itr != entries_.end()) {
+        Erase(itr->second);
+      }
+
+      lru_.emplace_front();
+      Entry& entry = lru_.front();
+      entry.key = key;
+      entry.data = tile;
+      GetCells(key, entry.cells);
+      for (uint64_t cell : entry.cells) {
+        cells_[cell].push_back(lru_.begin());
+      }
+
+      entries_.emplace(key, lru_.begin());
+      stats_.bytes += tile->size();
+      Trim();
+      return tile;
+    }
+
+    /**
+     * @brief Fetches a tile, writing and caching it on a miss.
+     *
+     * @param key - tile key
+     * @param n_bytes - size of the tile
+     * @param write - size_t(void* output, size_t n_bytes) - fills a tile, returns bytes written (0 on failure - not cached)
+     * @return tile, or null if write failed
+     */
+    template <typename WriteFunc>
+    std::shared_ptr<const tile_type> GetOrWrite(const TileKey& key, size_t n_bytes, WriteFunc&& write) {
+      auto tile = Find(key);
+      if (tile != nullptr) {
+        return tile;
+      }
+
+      uint64_t epoch = GetEditEpoch();
+      tile_type data(n_bytes);
+      if (write(static_cast<void*>(data.data()), n_bytes) != n_bytes) {
+        return nullptr;
+      }
+
+      return Insert(key, std::move(data), epoch);
+    }
+
+    // drops every tile which overlaps a world rect
+    void Invalidate(const glm::dvec2& origin, const glm::dvec2& size) {
+      std::lock_guard<std::mutex> lock(lock_);
+      edit_epoch_++;
+
+      glm::dvec2 end = origin + size;
+      glm::ivec2 cell_begin = GetCell(origin);
+      glm::ivec2 cell_end = GetCell(end);
+
+      std::vector<list_type::iterator> hit;
+      for (int y = cell_begin.y; y <= cell_end.y; y++) {
+        for (int x = cell_begin.x; x <= cell_end.x; x++) {
+          auto cell = cells_.find(PackCell(x, y));
+          if (cell == cells_.end()) {
+            continue;
+          }
+
+          for (auto& entry : cell->second) {
+            glm::dvec2 tile_origin, tile_end;
+            GetRect(entry->key, tile_origin, tile_end);
+            // closed intervals - a tile sample on the box edge reads 0 either way, but be conservative
+            if (tile_origin.x <= end.x && tile_end.x >= origin.x && tile_origin.y <= end.y && tile_end.y >= origin.y) {
+              hit.push_back(entry);
+            }
+          }
+        }
+      }
+
+      // tiles spanning several cells show up once per cell
+      std::sort(hit.begin(), hit.end(), [](const list_type::iterator& a, const list_type::iterator& b) { return &*a < &*b; });
+      hit.erase(std::unique(hit.begin(), hit.end()), hit.end());
+      for (auto& entry : hit) {
+        Erase(entry);
+        stats_.invalidations++;
+      }
+    }
+
+    void Clear() {
+      std::lock_guard<std::mutex> lock(lock_);
+      edit_epoch_++;
+      lru_.clear();
+      entries_.clear();
+      cells_.clear();
+      stats_.bytes = 0;
+    }
+
+    void SetBudget(size_t byte_budget) {
+      std::lock_guard<std::mutex> lock(lock_);
+      budget_ = byte_budget;
+      Trim();
+    }
+
+    size_t GetBudget() const {
+      std::lock_guard<std::mutex> lock(lock_);
+      return budget_;
+    }
+
+    // bumped by every invalidation - see Insert
+    uint64_t GetEditEpoch() const {
+      std::lock_guard<std::mutex> lock(lock_);
+      return edit_epoch_;
+    }
+
+    TileCacheStats GetStats() const {
+      std::lock_guard<std::mutex> lock(lock_);
+      TileCacheStats res = stats_;
+      res.entries = entries_.size();
+      return res;
+    }
+
+   private:
+    struct Entry {
+      TileKey key;
+      std::shared_ptr<const tile_type> data;
+      std::vector<uint64_t> cells;
+    };
+
+    typedef std::list<Entry> list_type;
+
+    struct KeyHash {
+      size_t operator()(const TileKey& key) const {
+        uint64_t words[7];
+        memcpy(&words[0], &key.origin.x, sizeof(double));
+        memcpy(&words[1], &key.origin.y, sizeof(double));
+        memcpy(&words[2], &key.scale, sizeof(double));
+        words[3] = static_cast<uint32_t>(key.dims.x);
+        words[4] = static_cast<uint32_t>(key.dims.y);
+        words[5] = key.layer;
+        words[6] = key.index;
+
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (uint64_t word : words) {
+          hash ^= word;
+          hash *= 0x100000001b3ULL;
+          hash ^= hash >> 29;
+        }
+
+        return static_cast<size_t>(hash);
+      }
+    };
+
+    // world rect covered by a tile's samples
+    static void GetRect(const TileKey& key, glm::dvec2& origin, glm::dvec2& end) {
+      origin = key.origin;
+      end = key.origin + glm::dvec2(glm::max(key.dims - glm::ivec2(1), glm::ivec2(0))) * key.scale;
+    }
+
+    static glm::ivec2 GetCell(const glm::dvec2& point) {
+      return glm::ivec2(glm::floor(point / _TILE_CACHE_CELL_SIZE));
+    }
+
+    static uint64_t PackCell(int x, int y) {
+      return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    static void GetCells(const TileKey& key, std::vector<uint64_t>& output) {
+      glm::dvec2 origin, end;
+      GetRect(key, origin, end);
+      glm::ivec2 cell_begin = GetCell(origin);
+      glm::ivec2 cell_end = GetCell(end);
+      for (int y = cell_begin.y; y <= cell_end.y; y++) {
+        for (int x = cell_begin.x; x <= cell_end.x; x++) {
+          output.push_back(PackCell(x, y));
+        }
+      }
+    }
+
+    // lock held
+    void Erase(list_type::iterator entry) {
+      for (uint64_t cell : entry->cells) {
+        auto itr = cells_.find(cell);
+        auto& list = itr->second;
+        for (size_t i = 0; i < list.size(); i++) {
+          if (list[i] == entry) {
+            list[i] = list.back();
+            list.pop_back();
+            break;
+          }
+        }
+
+        if (list.empty()) {
+          cells_.erase(itr);
+        }
+      }
+
+      stats_.bytes -= entry->data->size();
+      entries_.erase(entry->key);
+      lru_.erase(entry);
+    }
+
+    // lock held
+    void Trim() {
+      while (stats_.bytes > budget_ && !lru_.empty()) {
+        Erase(std::prev(lru_.end()));
+        stats_.evictions++;
+      }
+    }
+
+    size_t budget_;
+    uint64_t edit_epoch_ = 0;
+
+    // front is most recently used
+    list_type lru_;
+    std::unordered_map<TileKey, list_type::iterator, KeyHash> entries_;
+    std::unordered_map<uint64_t, std::vector<list_type::iterator>> cells_;
+
+    TileCacheStats stats_;
+    std::function<void()> detach_;
+    mutable std::mutex lock_;
+  };
+}
+
+#endif // CG_TILE_CACHE_H_
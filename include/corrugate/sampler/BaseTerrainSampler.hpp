@@ -19,9 +19,9 @@ namespace cg {
       std::shared_ptr<SplatType> splat,
       std::shared_ptr<TreeFillType> tree_fill
     ) :
-      height_(std::make_unique<SampleWriterGenericImpl<float, HeightType>>(heightmap)),
+      height_(std::make_unique<SampleWriterGenericImpl<float, HeightType, impl::HeightChunkWriteDelegate<HeightType>>>(heightmap)),
       splat_(std::make_unique<IndexedSampleWriterGenericImpl<glm::vec4, SplatType>>(splat)),
-      tree_fill_(std::make_unique<SampleWriterGenericImpl<float, TreeFillType>>(tree_fill))
+      tree_fill_(std::make_unique<SampleWriterGenericImpl<float, TreeFillType, impl::TreeFillChunkWriteDelegate<TreeFillType>>>(tree_fill))
     {}
 
     float SampleHeight(double x, double y) const {
@@ -63,6 +63,19 @@ namespace cg {
       return splat_->WriteChunk(origin, sample_dims, scale.AsDouble(), index, output, n_bytes);
     }
 
+    // indices [first_index, first_index + count), planes back to back
+    size_t WriteSplatLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      const chunker::util::Fraction& scale,
+      size_t first_index,
+      size_t count,
+      glm::vec4* output,
+      size_t n_bytes
+    ) const {
+      return splat_->WriteChunkLayers(origin, sample_dims, scale.AsDouble(), first_index, count, output, n_bytes);
+    }
+
     size_t WriteTreeFill(
       const glm::dvec2& origin,
       const glm::ivec2& sample_dims,
@@ -0,0 +1,52 @@
+#ifndef CG_BOX_SPAN_H_
+#define CG_BOX_SPAN_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace cg {
+  /**
+   * @brief Boxes read by a multi-box sampler.
+   *        Either owned (built from a container of shared_ptrs, which the span keeps alive),
+   *        or borrowed (raw pointers which the caller keeps alive - e.g. gathered from a pinned snapshot
+   *        for a single tile, so building a sampler doesn't allocate or touch refcounts).
+   */
+  template <typename BoxType>
+  class BoxSpan {
+   public:
+    template <typename IterableType>
+    BoxSpan(const IterableType& contents) : owned_(contents.begin(), contents.end()) {
+      pointers_.reserve(owned_.size());
+      for (auto& box : owned_) {
+        pointers_.push_back(box.get());
+      }
+
+      data_ = pointers_.data();
+      count_ = pointers_.size();
+    }
+
+    BoxSpan(const BoxType* const* boxes, size_t count) : data_(boxes), count_(count) {}
+
+    // owned copies point at their own pointers, borrowed copies share the caller's
+    BoxSpan(const BoxSpan& other) : owned_(other.owned_), pointers_(other.pointers_), data_(pointers_.empty() ? other.data_ : pointers_.data()), count_(other.count_) {}
+    BoxSpan& operator=(const BoxSpan&) = delete;
+
+    const BoxType* const* data() const { return data_; }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    const BoxType* const* begin() const { return data_; }
+    const BoxType* const* end() const { return data_ + count_; }
+    const BoxType* operator[](size_t i) const { return data_[i]; }
+
+   private:
+    std::vector<std::shared_ptr<const BoxType>> owned_;
+    std::vector<const BoxType*> pointers_;
+
+    const BoxType* const* data_;
+    size_t count_;
+  };
+}
+
+#endif // CG_BOX_SPAN_H_
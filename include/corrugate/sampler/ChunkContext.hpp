@@ -0,0 +1,82 @@
+#ifndef CHUNK_CONTEXT_H_
+#define CHUNK_CONTEXT_H_
+
+#include "corrugate/FeatureBox.hpp"
+#include "corrugate/sampler/DataSampler.hpp"
+#include "corrugate/util/Workspace.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+
+namespace cg {
+  // state shared by every layer written for one chunk
+  // - falloff sum is built once, by scattering each box's footprint into it,
+  //   then reused by splat, tree fill and smoothing writes
+  class ChunkContext {
+   public:
+    /**
+     * @brief Creates a context for a chunk, with an empty falloff sum.
+     *        Scratch comes from workspace - the context is valid until the scope it was created in closes.
+     *
+     * @param origin - global origin of the chunk
+     * @param sample_dims - num of x/y samples
+     * @param scale - distance between samples
+     * @param workspace - scratch for the falloff sum, and for writes using this context
+     */
+    ChunkContext(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, Workspace& workspace)
+    : origin(origin),
+      sample_dims(sample_dims),
+      scale(scale),
+      workspace_(workspace),
+      falloff_sum_(workspace.Allocate<float>(static_cast<size_t>(sample_dims.x) * sample_dims.y)) {
+      std::fill(falloff_sum_, falloff_sum_ + GetElementCount(), 0.0f);
+    }
+
+    ChunkContext(const ChunkContext&) = delete;
+    ChunkContext& operator=(const ChunkContext&) = delete;
+
+    // scatters a box's falloff into the sum
+    void AddFalloff(const FeatureBox& box) {
+      box.AccumulateFalloff(origin, sample_dims, scale, falloff_sum_);
+      box_count_++;
+    }
+
+    const float* GetFalloffSum() const {
+      return falloff_sum_;
+    }
+
+    DataSampler<float> GetFalloffSampler() const {
+      return DataSampler<float>(sample_dims, falloff_sum_);
+    }
+
+    // view of the falloff sum for a block of this chunk
+    DataSampler<float> GetFalloffSampler(const glm::ivec2& block_start, const glm::ivec2& block_dims) const {
+      return DataSampler<float>(block_dims, falloff_sum_ + static_cast<size_t>(block_start.y) * sample_dims.x + block_start.x, sample_dims.x);
+    }
+
+    size_t GetElementCount() const {
+      return static_cast<size_t>(sample_dims.x) * sample_dims.y;
+    }
+
+    // number of boxes scattered into the sum
+    size_t GetBoxCount() const {
+      return box_count_;
+    }
+
+    Workspace& GetWorkspace() const {
+      return workspace_;
+    }
+
+    const glm::dvec2 origin;
+    const glm::ivec2 sample_dims;
+    const double scale;
+
+   private:
+    Workspace& workspace_;
+    float* falloff_sum_;
+    size_t box_count_ = 0;
+  };
+}
+
+#endif // CHUNK_CONTEXT_H_
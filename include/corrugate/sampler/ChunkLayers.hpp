@@ -0,0 +1,134 @@
+#ifndef CHUNK_LAYERS_H_
+#define CHUNK_LAYERS_H_
+
+#include "corrugate/simd/Quantize.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cg {
+  // layers which can be written in one pass
+  enum LayerMask : uint32_t {
+    LAYER_HEIGHT    = 1 << 0,
+    LAYER_SPLAT     = 1 << 1,
+    LAYER_TREE_FILL = 1 << 2,
+    LAYER_ALL       = LAYER_HEIGHT | LAYER_SPLAT | LAYER_TREE_FILL
+  };
+
+  // outputs for a multi-layer write
+  // - every output holds sample_dims.x * sample_dims.y elements
+  // - splat holds splat_count of those planes back to back, for indices [splat_first, splat_first + splat_count)
+  struct ChunkLayers {
+    uint32_t mask = 0;
+
+    float* height = nullptr;
+
+    glm::vec4* splat = nullptr;
+    size_t splat_first = 0;
+    size_t splat_count = 0;
+
+    float* tree_fill = nullptr;
+
+    bool Has(LayerMask layer) const {
+      return (mask & layer) != 0;
+    }
+
+    // total bytes written for a chunk of sample_dims
+    size_t GetByteCount(const glm::ivec2& sample_dims) const {
+      size_t elems = static_cast<size_t>(sample_dims.x) * sample_dims.y;
+      size_t bytes = 0;
+      if (Has(LAYER_HEIGHT)) {
+        bytes += elems * sizeof(float);
+      }
+
+      if (Has(LAYER_SPLAT)) {
+        bytes += elems * splat_count * sizeof(glm::vec4);
+      }
+
+      if (Has(LAYER_TREE_FILL)) {
+        bytes += elems * sizeof(float);
+      }
+
+      return bytes;
+    }
+  };
+
+  // formats for quantized height
+  enum HeightFormat : uint32_t {
+    // uint16, height_min -> 0 and height_max -> 65535 (clamped)
+    HEIGHT_R16_UNORM,
+    // ieee half float (range unused)
+    HEIGHT_R16F
+  };
+
+  // quantized outputs for a multi-layer write - same layout as ChunkLayers, smaller elements
+  // - height: one uint16 per sample, see HeightFormat
+  // - splat: rgba8 unorm (4 bytes per sample), clamped to [0, 1]
+  // - tree fill: r8 unorm, clamped to [0, 1]
+  // samples are converted a block at a time as they're composited, so full float chunks never exist
+  struct QuantizedChunkLayers {
+    uint32_t mask = 0;
+
+    uint16_t* height = nullptr;
+    HeightFormat height_format = HEIGHT_R16_UNORM;
+    float height_min = 0.0f;
+    float height_max = 1.0f;
+
+    uint8_t* splat = nullptr;
+    size_t splat_first = 0;
+    size_t splat_count = 0;
+
+    uint8_t* tree_fill = nullptr;
+
+    bool Has(LayerMask layer) const {
+      return (mask & layer) != 0;
+    }
+
+    size_t GetByteCount(const glm::ivec2& sample_dims) const {
+      size_t elems = static_cast<size_t>(sample_dims.x) * sample_dims.y;
+      size_t bytes = 0;
+      if (Has(LAYER_HEIGHT)) {
+        bytes += elems * sizeof(uint16_t);
+      }
+
+      if (Has(LAYER_SPLAT)) {
+        bytes += elems * splat_count * 4;
+      }
+
+      if (Has(LAYER_TREE_FILL)) {
+        bytes += elems;
+      }
+
+      return bytes;
+    }
+
+    // float layers with the same mask and splat range (no outputs)
+    ChunkLayers GetFloatLayers() const {
+      ChunkLayers res;
+      res.mask = mask;
+      res.splat_first = splat_first;
+      res.splat_count = splat_count;
+      return res;
+    }
+
+    void QuantizeHeight(const float* input, int count, uint16_t* output) const {
+      if (height_format == HEIGHT_R16F) {
+        simd::QuantizeHalf(input, count, output);
+      } else {
+        simd::QuantizeUnorm16(input, count, height_min, height_max, output);
+      }
+    }
+
+    static void QuantizeSplat(const glm::vec4* input, int count, uint8_t* output) {
+      simd::QuantizeUnorm8(reinterpret_cast<const float*>(input), count * 4, output);
+    }
+
+    static void QuantizeTreeFill(const float* input, int count, uint8_t* output) {
+      simd::QuantizeUnorm8(input, count, output);
+    }
+  };
+}
+
+#endif // CHUNK_LAYERS_H_
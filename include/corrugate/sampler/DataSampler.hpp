@@ -9,11 +9,14 @@ namespace cg {
     // map to preexisting data
    public:
     // does not take ownership of data
-    DataSampler(const glm::ivec2& data_size, DataType* data) : data_size(data_size), data_(data) {}
+    DataSampler(const glm::ivec2& data_size, const DataType* data) : DataSampler(data_size, data, data_size.x) {}
+
+    // view of a sub rect of a larger buffer - stride is the row length of that buffer
+    DataSampler(const glm::ivec2& data_size, const DataType* data, int stride) : data_size(data_size), data_(data), stride_(stride) {}
 
     DataType Get(int x, int y) const {
       if (x >= 0 && x < data_size.x && y >= 0 && y < data_size.y) {
-        return data_[y * data_size.x + x];
+        return data_[static_cast<size_t>(y) * stride_ + x];
       }
 
       return DataType{};
@@ -23,6 +26,7 @@ namespace cg {
 
    private:
     const DataType* data_;
+    int stride_;
   };
 }
 
@@ -2,11 +2,25 @@
 #define MULTI_BOX_SAMPLER_H_
 
 #include "corrugate/box/SamplerBox.hpp"
+#include "corrugate/sampler/BoxSpan.hpp"
+#include "corrugate/sampler/ChunkContext.hpp"
+#include "corrugate/sampler/ChunkLayers.hpp"
+#include "corrugate/util/Metrics.hpp"
+#include "corrugate/util/Workspace.hpp"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
+// default block edge (in samples) when compositing chunks
+// - 64x64 floats is 16KB, so a block + its temp stay in L1/L2
+#define _COMPOSITE_TILE_SIZE 64
+
 namespace cg {
   // collates samples from multiple boxes (better name)
   template <typename BoxType>
@@ -17,7 +31,10 @@ namespace cg {
 
     // this kicks ass lol
     template <typename IterableType>
-    MultiBoxSampler(const IterableType& contents) : samplers(contents.begin(), contents.end()) {}
+    MultiBoxSampler(const IterableType& contents) : samplers(contents) {}
+
+    // borrows boxes - they must outlive the sampler
+    MultiBoxSampler(const BoxType* const* boxes, size_t count) : samplers(boxes, count) {}
 
     template <>
     MultiBoxSampler(const std::vector<std::shared_ptr<const BoxType>>& contents) : samplers(contents) {}
@@ -75,37 +92,17 @@ namespace cg {
       const glm::ivec2& sample_dims,
       double scale,
       float* output,
-      size_t n_bytes
+      size_t n_bytes,
+      Workspace* workspace = nullptr
     ) const {
-      size_t elems = sample_dims.x * sample_dims.y;
-      size_t bytes = elems * sizeof(float);
-
-      if (bytes > n_bytes) {
+      if (static_cast<size_t>(sample_dims.x) * sample_dims.y * sizeof(float) > n_bytes) {
         return 0;
       }
 
-      float* temp = new float[elems];
-      memset(output, 0, bytes);
-      // seems like for all of these, we want to average out using the same strat (except for height)
-      for (auto& sampler : samplers) {
-        size_t written = sampler->WriteHeight(
-          origin,
-          sample_dims,
-          scale,
-          temp,
-          n_bytes
-        );
-
-        assert(written == bytes);
-
-        for (size_t i = 0; i < elems; i++) {
-          // accrue sampler values into output
-          output[i] += temp[i];
-        }
-      }
-
-      delete[] temp;
-      return bytes;
+      ChunkLayers layers;
+      layers.mask = LAYER_HEIGHT;
+      layers.height = output;
+      return WriteLayers(origin, sample_dims, scale, layers, workspace);
     }
 
     size_t WriteSplat(
@@ -114,98 +111,169 @@ namespace cg {
       double scale,
       size_t index,
       glm::vec4* output,
-      size_t n_bytes
+      size_t n_bytes,
+      Workspace* workspace = nullptr
     ) const {
-      size_t elems = sample_dims.x * sample_dims.y;
-      size_t bytes = elems * sizeof(glm::vec4);
-      if (bytes > n_bytes) {
+      if (static_cast<size_t>(sample_dims.x) * sample_dims.y * sizeof(glm::vec4) > n_bytes) {
         return 0;
       }
 
-      glm::vec4* temp = new glm::vec4[elems];
-      float* falloffs = new float[elems];
-      memset(temp, 0, bytes);
-      memset(output, 0, bytes);
-      WriteFalloffSum(
-        origin,
-        sample_dims,
-        scale,
-        falloffs,
-        elems * sizeof(float)
-      );
-
-      DataSampler<float> falloff_sampler(sample_dims, falloffs);
+      ChunkLayers layers;
+      layers.mask = LAYER_SPLAT;
+      layers.splat = output;
+      layers.splat_first = index;
+      layers.splat_count = 1;
+      return WriteLayers(origin, sample_dims, scale, layers, workspace);
+    }
 
-      for (auto& sampler : samplers) {
-        sampler->WriteSplat(
-          origin,
-          sample_dims,
-          scale,
-          index,
-          temp,
-          n_bytes,
-          &falloff_sampler
-        );
-
-        for (size_t i = 0; i < elems; i++) {
-          output[i] += temp[i];
-        }
+    size_t WriteTreeFill(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      float* output,
+      size_t n_bytes,
+      Workspace* workspace = nullptr
+    ) const {
+      if (static_cast<size_t>(sample_dims.x) * sample_dims.y * sizeof(float) > n_bytes) {
+        return 0;
       }
 
-      delete[] temp;
-      delete[] falloffs;
+      ChunkLayers layers;
+      layers.mask = LAYER_TREE_FILL;
+      layers.tree_fill = output;
+      return WriteLayers(origin, sample_dims, scale, layers, workspace);
+    }
 
-      return bytes;
+    /**
+     * @brief Writes every layer in layers.mask in a single traversal of the chunk.
+     *        Each block gathers its boxes once, and each box evaluates its falloff once for all layers.
+     *
+     * @param origin - global origin
+     * @param sample_dims - num of x/y samples
+     * @param scale - scale of sampling
+     * @param layers - outputs, each sized for sample_dims
+     * @param workspace - scratch (thread-local workspace if null)
+     * @return size_t - number of bytes written, across all layers
+     */
+    size_t WriteLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      const ChunkLayers& layers,
+      Workspace* workspace = nullptr
+    ) const {
+      Workspace& ws = (workspace != nullptr ? *workspace : Workspace::Local());
+      if (!layers.Has(LAYER_TREE_FILL)) {
+        // only tree fill reads the falloff sum
+        return CompositeLayers(origin, sample_dims, scale, layers, nullptr, ws);
+      }
+
+      Workspace::Scope scope(ws);
+      ChunkContext context(origin, sample_dims, scale, ws);
+      PrepareContext(context);
+      return CompositeLayers(origin, sample_dims, scale, layers, &context, ws);
     }
 
-    size_t WriteTreeFill(
+    /**
+     * @brief Writes every layer in layers.mask in a single traversal, quantizing as blocks finish.
+     *        Same as the float WriteLayers, but only block sized float temps are ever allocated.
+     *
+     * @param origin - global origin
+     * @param sample_dims - num of x/y samples
+     * @param scale - scale of sampling
+     * @param layers - quantized outputs, each sized for sample_dims
+     * @param workspace - scratch (thread-local workspace if null)
+     * @return size_t - number of bytes written, across all layers
+     */
+    size_t WriteLayers(
       const glm::dvec2& origin,
       const glm::ivec2& sample_dims,
       double scale,
-      float* output,
-      size_t n_bytes
+      const QuantizedChunkLayers& layers,
+      Workspace* workspace = nullptr
     ) const {
-      size_t elems = sample_dims.x * sample_dims.y;
-      size_t bytes = elems * sizeof(float);
+      Workspace& ws = (workspace != nullptr ? *workspace : Workspace::Local());
+      if (!layers.Has(LAYER_TREE_FILL)) {
+        return CompositeLayers(origin, sample_dims, scale, layers, nullptr, ws);
+      }
 
-      if (bytes > n_bytes) {
+      Workspace::Scope scope(ws);
+      ChunkContext context(origin, sample_dims, scale, ws);
+      PrepareContext(context);
+      return CompositeLayers(origin, sample_dims, scale, layers, &context, ws);
+    }
+
+    /**
+     * @brief Scatters every box's falloff into a chunk context.
+     *        Call once per chunk, then write any number of layers with the context.
+     *
+     * @param context - context for the chunk being written
+     */
+    void PrepareContext(ChunkContext& context) const {
+      CG_METRIC_STAGE(STAGE_FALLOFF);
+      for (auto& sampler : samplers) {
+        context.AddFalloff(*sampler);
+      }
+    }
+
+    // layer writes which reuse a prepared context (scratch comes from the context's workspace)
+
+    size_t WriteLayers(const ChunkContext& context, const ChunkLayers& layers) const {
+      return CompositeLayers(context.origin, context.sample_dims, context.scale, layers, &context, context.GetWorkspace());
+    }
+
+    size_t WriteLayers(const ChunkContext& context, const QuantizedChunkLayers& layers) const {
+      return CompositeLayers(context.origin, context.sample_dims, context.scale, layers, &context, context.GetWorkspace());
+    }
+
+    size_t WriteHeight(const ChunkContext& context, float* output, size_t n_bytes) const {
+      if (context.GetElementCount() * sizeof(float) > n_bytes) {
         return 0;
       }
 
-      float* temp = new float[elems];
-      float* falloffs = new float[elems];
-      memset(temp, 0, bytes);
-      memset(output, 0, bytes);
-      WriteFalloffSum(
-        origin,
-        sample_dims,
-        scale,
-        falloffs,
-        bytes
-      );
+      ChunkLayers layers;
+      layers.mask = LAYER_HEIGHT;
+      layers.height = output;
+      return WriteLayers(context, layers);
+    }
 
-      DataSampler<float> falloff_sampler(sample_dims, falloffs);
+    size_t WriteSplat(const ChunkContext& context, size_t index, glm::vec4* output, size_t n_bytes) const {
+      if (context.GetElementCount() * sizeof(glm::vec4) > n_bytes) {
+        return 0;
+      }
 
-      for (auto& sampler : samplers) {
-        sampler->WriteTreeFill(
-          origin,
-          sample_dims,
-          scale,
-          temp,
-          n_bytes,
-          &falloff_sampler
-        );
-
-        for (size_t i = 0; i < elems; i++) {
-          // accrue sampler values into output
-          output[i] += temp[i];
-        }
+      ChunkLayers layers;
+      layers.mask = LAYER_SPLAT;
+      layers.splat = output;
+      layers.splat_first = index;
+      layers.splat_count = 1;
+      return WriteLayers(context, layers);
+    }
+
+    size_t WriteTreeFill(const ChunkContext& context, float* output, size_t n_bytes) const {
+      if (context.GetElementCount() * sizeof(float) > n_bytes) {
+        return 0;
       }
 
-      delete[] temp;
-      delete[] falloffs;
+      ChunkLayers layers;
+      layers.mask = LAYER_TREE_FILL;
+      layers.tree_fill = output;
+      return WriteLayers(context, layers);
+    }
 
-      return bytes;
+    /**
+     * @brief Sets the edge length of the blocks used when compositing chunks.
+     *        Each block is finished (every overlapping box accumulated) before moving on,
+     *        so the block and its temp stay in cache instead of streaming the whole chunk once per box.
+     *
+     * @param tile_size - block edge, in samples - 0 composites the whole chunk at once
+     */
+    void SetTileSize(int tile_size) {
+      tile_size_ = std::max(tile_size, 0);
+    }
+
+    int GetTileSize() const {
+      return tile_size_;
     }
 
     float SampleFalloffSum(const glm::dvec2& coords) const {
@@ -233,22 +301,259 @@ namespace cg {
         return 0;
       }
 
+      CG_METRIC_STAGE(STAGE_FALLOFF);
       memset(output, 0, bytes);
 
-      glm::dvec2 coords;
-      for (size_t y = 0; y < sample_dims.y; y++) {
-        coords.y = y * scale + origin.y;
-        for (size_t x = 0; x < sample_dims.x; x++) {
-          coords.x = x * scale + origin.x;
-          output[y * sample_dims.x + x] = SampleFalloffSum(coords);
-        }
+      // scatter each box's footprint - same summation order as SampleFalloffSum
+      for (auto& sampler : samplers) {
+        sampler->AccumulateFalloff(origin, sample_dims, scale, output);
       }
 
       return bytes;
     }
 
    private:
-    const vector_type samplers;
+    const BoxSpan<BoxType> samplers;
+    int tile_size_ = _COMPOSITE_TILE_SIZE;
+
+    // final accumulation straight into float outputs
+    class FloatSink {
+     public:
+      FloatSink(const ChunkLayers& layers, const glm::ivec2& sample_dims) : layers_(layers), sample_dims_(sample_dims) {}
+
+      void Begin(const ChunkLayers& temp, const glm::ivec2& block_start, const glm::ivec2& block_dims) {
+        ForEachLayer(layers_, temp, GetElems(), block_dims.x * block_dims.y, [&](auto* output, auto*) {
+          ClearBlock(output, sample_dims_, block_start, block_dims);
+        });
+      }
+
+      void Accumulate(const ChunkLayers& temp, const glm::ivec2& block_start, const glm::ivec2& block_dims) {
+        ForEachLayer(layers_, temp, GetElems(), block_dims.x * block_dims.y, [&](auto* output, auto* block) {
+          AccumulateBlock(block, output, sample_dims_, block_start, block_dims);
+        });
+      }
+
+      void End(const glm::ivec2&, const glm::ivec2&) {}
+
+     private:
+      const ChunkLayers& layers_;
+      glm::ivec2 sample_dims_;
+
+      size_t GetElems() const {
+        return static_cast<size_t>(sample_dims_.x) * sample_dims_.y;
+      }
+    };
+
+    // final accumulation into block sized float planes, converted into quantized outputs once the block is done
+    class QuantizedSink {
+     public:
+      QuantizedSink(const QuantizedChunkLayers& layers, const glm::ivec2& sample_dims, const glm::ivec2& tile_dims, Workspace& ws)
+      : layers_(layers), sample_dims_(sample_dims), acc_(layers.GetFloatLayers()) {
+        size_t tile_elems = static_cast<size_t>(tile_dims.x) * tile_dims.y;
+        acc_.height = (layers.Has(LAYER_HEIGHT) ? ws.Allocate<float>(tile_elems) : nullptr);
+        acc_.splat = (layers.Has(LAYER_SPLAT) ? ws.Allocate<glm::vec4>(tile_elems * layers.splat_count) : nullptr);
+        acc_.tree_fill = (layers.Has(LAYER_TREE_FILL) ? ws.Allocate<float>(tile_elems) : nullptr);
+      }
+
+      void Begin(const ChunkLayers&, const glm::ivec2&, const glm::ivec2& block_dims) {
+        size_t block_elems = block_dims.x * block_dims.y;
+        ForEachLayer(acc_, acc_, block_elems, block_elems, [&](auto* acc, auto*) {
+          std::fill(acc, acc + block_elems, std::remove_pointer_t<decltype(acc)>(0));
+        });
+      }
+
+      void Accumulate(const ChunkLayers& temp, const glm::ivec2&, const glm::ivec2& block_dims) {
+        size_t block_elems = block_dims.x * block_dims.y;
+        ForEachLayer(acc_, temp, block_elems, block_elems, [&](auto* acc, auto* block) {
+          for (size_t i = 0; i < block_elems; i++) {
+            acc[i] += block[i];
+          }
+        });
+      }
+
+      void End(const glm::ivec2& block_start, const glm::ivec2& block_dims) {
+        CG_METRIC_STAGE(STAGE_ACCUMULATE);
+        size_t elems = static_cast<size_t>(sample_dims_.x) * sample_dims_.y;
+        size_t block_elems = block_dims.x * block_dims.y;
+        for (int y = 0; y < block_dims.y; y++) {
+          size_t out_offset = static_cast<size_t>(block_start.y + y) * sample_dims_.x + block_start.x;
+          size_t acc_offset = static_cast<size_t>(y) * block_dims.x;
+          if (layers_.Has(LAYER_HEIGHT)) {
+            layers_.QuantizeHeight(acc_.height + acc_offset, block_dims.x, layers_.height + out_offset);
+          }
+
+          if (layers_.Has(LAYER_SPLAT)) {
+            for (size_t i = 0; i < layers_.splat_count; i++) {
+              QuantizedChunkLayers::QuantizeSplat(acc_.splat + i * block_elems + acc_offset, block_dims.x, layers_.splat + (i * elems + out_offset) * 4);
+            }
+          }
+
+          if (layers_.Has(LAYER_TREE_FILL)) {
+            QuantizedChunkLayers::QuantizeTreeFill(acc_.tree_fill + acc_offset, block_dims.x, layers_.tree_fill + out_offset);
+          }
+        }
+      }
+
+     private:
+      const QuantizedChunkLayers& layers_;
+      glm::ivec2 sample_dims_;
+      // block sized float planes
+      ChunkLayers acc_;
+    };
+
+    glm::ivec2 GetTileDims(const glm::ivec2& sample_dims) const {
+      return (tile_size_ > 0 ? glm::min(glm::ivec2(tile_size_), sample_dims) : sample_dims);
+    }
+
+    size_t CompositeLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      const ChunkLayers& layers,
+      const ChunkContext* context,
+      Workspace& ws
+    ) const {
+      FloatSink sink(layers, sample_dims);
+      CompositeLayers(origin, sample_dims, scale, layers, sink, context, ws);
+
+      size_t bytes = layers.GetByteCount(sample_dims);
+      CG_METRIC_ADD(COUNTER_BYTES_WRITTEN, bytes);
+      return bytes;
+    }
+
+    size_t CompositeLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      const QuantizedChunkLayers& layers,
+      const ChunkContext* context,
+      Workspace& ws
+    ) const {
+      Workspace::Scope scope(ws);
+      QuantizedSink sink(layers, sample_dims, GetTileDims(sample_dims), ws);
+      CompositeLayers(origin, sample_dims, scale, layers.GetFloatLayers(), sink, context, ws);
+
+      size_t bytes = layers.GetByteCount(sample_dims);
+      CG_METRIC_ADD(COUNTER_BYTES_WRITTEN, bytes);
+      return bytes;
+    }
+
+    // writes every overlapping box into block-sized temps, then hands them to the sink - one block at a time
+    // - request gives the layers to write (outputs unused - those belong to the sink)
+    // - tree fill reads falloffs from context (null if tree fill isn't requested)
+    template <typename Sink>
+    void CompositeLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      const ChunkLayers& request,
+      Sink& sink,
+      const ChunkContext* context,
+      Workspace& ws
+    ) const {
+      glm::ivec2 tile_dims = GetTileDims(sample_dims);
+      size_t tile_elems = tile_dims.x * tile_dims.y;
+
+      Workspace::Scope scope(ws);
+
+      // same layers, block sized
+      ChunkLayers temp = request;
+      temp.height = (request.Has(LAYER_HEIGHT) ? ws.Allocate<float>(tile_elems) : nullptr);
+      temp.splat = (request.Has(LAYER_SPLAT) ? ws.Allocate<glm::vec4>(tile_elems * request.splat_count) : nullptr);
+      temp.tree_fill = (request.Has(LAYER_TREE_FILL) ? ws.Allocate<float>(tile_elems) : nullptr);
+
+      const BoxType** overlapping = ws.Allocate<const BoxType*>(samplers.size());
+
+      for (int ty = 0; ty < sample_dims.y; ty += tile_dims.y) {
+        for (int tx = 0; tx < sample_dims.x; tx += tile_dims.x) {
+          glm::ivec2 block_start(tx, ty);
+          glm::ivec2 block_dims = glm::min(tile_dims, sample_dims - block_start);
+          glm::dvec2 block_origin = origin + glm::dvec2(block_start) * scale;
+
+          sink.Begin(temp, block_start, block_dims);
+
+          size_t overlap_count;
+          {
+            CG_METRIC_STAGE(STAGE_FETCH);
+            overlap_count = GatherOverlapping(block_origin, block_dims, scale, overlapping);
+          }
+
+          CG_METRIC_ADD(COUNTER_BOXES_WRITTEN, overlap_count);
+
+          DataSampler<float> falloff_sampler = (context != nullptr ? context->GetFalloffSampler(block_start, block_dims) : DataSampler<float>(block_dims, nullptr));
+
+          for (size_t i = 0; i < overlap_count; i++) {
+            {
+              CG_METRIC_STAGE(STAGE_SAMPLE);
+              size_t written = overlapping[i]->WriteLayers(block_origin, block_dims, scale, temp, (context != nullptr ? &falloff_sampler : nullptr), ws);
+              assert(written == temp.GetByteCount(block_dims));
+            }
+
+            // accrue sampler values into outputs
+            CG_METRIC_STAGE(STAGE_ACCUMULATE);
+            sink.Accumulate(temp, block_start, block_dims);
+          }
+
+          // quantized sinks convert here - blocks without boxes still need their zeroes converted
+          sink.End(block_start, block_dims);
+        }
+      }
+    }
+
+    // calls func(output plane, temp plane) for every requested layer (each splat index is a plane)
+    template <typename Func>
+    static void ForEachLayer(const ChunkLayers& layers, const ChunkLayers& temp, size_t elems, size_t block_elems, Func&& func) {
+      if (layers.Has(LAYER_HEIGHT)) {
+        func(layers.height, temp.height);
+      }
+
+      if (layers.Has(LAYER_SPLAT)) {
+        for (size_t i = 0; i < layers.splat_count; i++) {
+          func(layers.splat + i * elems, temp.splat + i * block_elems);
+        }
+      }
+
+      if (layers.Has(LAYER_TREE_FILL)) {
+        func(layers.tree_fill, temp.tree_fill);
+      }
+    }
+
+    template <typename DataType>
+    static void ClearBlock(DataType* output, const glm::ivec2& sample_dims, const glm::ivec2& block_start, const glm::ivec2& block_dims) {
+      for (int y = 0; y < block_dims.y; y++) {
+        DataType* row = output + static_cast<size_t>(block_start.y + y) * sample_dims.x + block_start.x;
+        std::fill(row, row + block_dims.x, DataType(0));
+      }
+    }
+
+    template <typename DataType>
+    static void AccumulateBlock(const DataType* block, DataType* output, const glm::ivec2& sample_dims, const glm::ivec2& block_start, const glm::ivec2& block_dims) {
+      for (int y = 0; y < block_dims.y; y++) {
+        DataType* row = output + static_cast<size_t>(block_start.y + y) * sample_dims.x + block_start.x;
+        const DataType* block_row = block + static_cast<size_t>(y) * block_dims.x;
+        for (int x = 0; x < block_dims.x; x++) {
+          row[x] += block_row[x];
+        }
+      }
+    }
+
+    // boxes only contribute strictly inside their footprint (falloff is 0 on the edge and beyond)
+    size_t GatherOverlapping(const glm::dvec2& block_origin, const glm::ivec2& block_dims, double scale, const BoxType** output) const {
+      glm::dvec2 block_last = block_origin + glm::dvec2(block_dims - glm::ivec2(1)) * scale;
+      size_t count = 0;
+      for (auto& sampler : samplers) {
+        glm::dvec2 box_origin = sampler->GetOrigin();
+        glm::dvec2 box_end = sampler->GetEnd();
+        if (
+             box_origin.x < block_last.x    && box_origin.y < block_last.y
+          && box_end.x    > block_origin.x  && box_end.y    > block_origin.y
+        ) {
+          output[count++] = sampler;
+        }
+      }
+
+      return count;
+    }
   };
 }
 
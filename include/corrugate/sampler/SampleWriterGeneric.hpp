@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 
 #include "corrugate/sampler/SingleIndexSplatManager.hpp"
+#include "corrugate/sampler/impl/ChunkWriteDelegate.hpp"
 
 // for splat manager: how to handle?
 // prob just a thin wrapper that picks a specific sample
@@ -11,7 +12,7 @@ namespace cg {
   template <typename DataType>
   class SampleWriterGeneric {
    public:
-    virtual DataType Sample(double x, double y) const;
+    virtual DataType Sample(double x, double y) const = 0;
     virtual size_t WriteChunk(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, DataType* output, size_t n_bytes) const = 0;
     virtual ~SampleWriterGeneric() {}
   };
@@ -19,12 +20,30 @@ namespace cg {
   template <typename DataType>
   class IndexedSampleWriterGeneric {
     public:
-     virtual DataType Sample(double x, double y, size_t index) const;
+     virtual DataType Sample(double x, double y, size_t index) const = 0;
      virtual size_t WriteChunk(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t index, DataType* output, size_t n_bytes) const = 0;
+
+     // writes indices [first_index, first_index + count) as planes back to back
+     virtual size_t WriteChunkLayers(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t first_index, size_t count, DataType* output, size_t n_bytes) const {
+       size_t plane_elems = static_cast<size_t>(sample_dims.x) * sample_dims.y;
+       size_t plane_bytes = plane_elems * sizeof(DataType);
+       if (plane_bytes * count > n_bytes) {
+         return 0;
+       }
+
+       for (size_t i = 0; i < count; i++) {
+         if (WriteChunk(origin, sample_dims, scale, first_index + i, output + i * plane_elems, plane_bytes) != plane_bytes) {
+           return 0;
+         }
+       }
+
+       return plane_bytes * count;
+     }
      virtual ~IndexedSampleWriterGeneric() {};
   };
 
-  template <typename DataType, typename SamplerType>
+  // WriteDelegate picks how chunks are written - per sample by default, see impl::HeightChunkWriteDelegate
+  template <typename DataType, typename SamplerType, typename WriteDelegate = impl::SampleChunkWriteDelegate<DataType, SamplerType>>
   class SampleWriterGenericImpl : public SampleWriterGeneric<DataType> {
    public:
     SampleWriterGenericImpl(std::shared_ptr<SamplerType> sampler) : sampler_(sampler) {}
@@ -33,8 +52,6 @@ namespace cg {
       return sampler_->Sample(x, y);
     }
 
-    // prob not gonna test this
-
     size_t WriteChunk(
       const glm::dvec2& origin,
       const glm::ivec2& sample_dims,
@@ -47,22 +64,8 @@ namespace cg {
         return 0;
       }
 
-      DataType data;
-      glm::dvec2 pos;
-
-      double scale_d = scale;
-
-      // side note: for splats we need to adjust by 0.5
-
-      for (int y = 0; y < sample_dims.y; y++) {
-        for (int x = 0; x < sample_dims.x; x++) {
-          pos.x = origin.x + x * scale_d;
-          pos.y = origin.y + y * scale_d;
-          output[y * sample_dims.x + x] = sampler_->Sample(pos.x, pos.y);
-        }
-      }
-
-      return required_space;
+      // forwards to the sampler's bulk writer, if it has one
+      return WriteDelegate::Write(*sampler_, origin, sample_dims, scale, output, n_bytes);
     }
    private:
     std::shared_ptr<SamplerType> sampler_;
@@ -84,14 +87,19 @@ namespace cg {
       DataType* output,
       size_t n_bytes
     ) const override {
-      SampleWriterGenericImpl<DataType, SingleIndexSplatManager<SplatType>> temp(std::make_shared<SingleIndexSplatManager<SplatType>>(splat_, index));
-      return temp.WriteChunk(
-        origin,
-        sample_dims,
-        scale,
-        output,
-        n_bytes
-      );
+      return impl::SplatChunkWriteDelegate<SplatType>::Write(splat_, origin, sample_dims, scale, index, output, n_bytes);
+    }
+
+    size_t WriteChunkLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      size_t first_index,
+      size_t count,
+      DataType* output,
+      size_t n_bytes
+    ) const override {
+      return impl::SplatLayersChunkWriteDelegate<SplatType>::Write(splat_, origin, sample_dims, scale, first_index, count, output, n_bytes);
     }
    private:
     std::shared_ptr<SplatType> splat_;
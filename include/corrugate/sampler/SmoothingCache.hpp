@@ -0,0 +1,257 @@
+#ifndef CG_SMOOTHING_CACHE_H_
+#define CG_SMOOTHING_CACHE_H_
+
+#include "corrugate/FeatureBox.hpp"
+#include "corrugate/MultiSampler.hpp"
+#include "corrugate/sampler/SmoothingTerrainSampler.hpp"
+#include "corrugate/util/TempFile.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// "CGSC"
+#define _SMOOTHING_CACHE_MAGIC 0x43534743U
+// bump when this layout changes - old files are ignored
+// (estimator changes are caught by the estimator key each file records)
+#define _SMOOTHING_CACHE_VERSION 2U
+
+namespace cg {
+  /**
+   * @brief Smoothing estimates keyed by box geometry, for one base terrain.
+   *        Saved to / loaded from a local file, so warm starts can seed every box's cache
+   *        instead of running CalculateOrigin again.
+   *
+   *        The fingerprint identifies the base terrain - a file saved with a different fingerprint,
+   *        or by a different estimator (SmoothingTerrainSampler::GetEstimatorKey), doesn't load. Use anything that changes when the terrain does (seed, asset hash),
+   *        or FingerprintSampler if there's nothing better.
+   */
+  class SmoothingCache {
+   public:
+    SmoothingCache(uint64_t fingerprint) : fingerprint_(fingerprint) {}
+
+    uint64_t GetFingerprint() const {
+      return fingerprint_;
+    }
+
+    size_t size() const {
+      std::lock_guard<std::mutex> lock(lock_);
+      return entries_.size();
+    }
+
+    bool Find(const FeatureBox& box, SmoothingEstimate& output) const {
+      std::lock_guard<std::mutex> lock(lock_);
+      auto itr = entries_.find(GetKey(box));
+      if (itr == entries_.end()) {
+        return false;
+      }
+
+      output = itr->second;
+      return true;
+    }
+
+    void Store(const FeatureBox& box, const SmoothingEstimate& estimate) {
+      std::lock_guard<std::mutex> lock(lock_);
+      entries_[GetKey(box)] = estimate;
+    }
+
+    /**
+     * @brief Seeds every unprepared box with a stored estimate, where there is one.
+     * @return size_t - number of boxes seeded
+     */
+    template <typename BoxType>
+    size_t Apply(const MultiSampler<BoxType>& boxes) const {
+      size_t hits = 0;
+      SmoothingEstimate estimate;
+      for (auto& box : boxes) {
+        if (!box->IsCachePrepared() && Find(*box, estimate)) {
+          box->SetSmoothingEstimate(estimate);
+          hits++;
+        }
+      }
+
+      return hits;
+    }
+
+    /**
+     * @brief Stores the estimate of every prepared box.
+     * @return size_t - number of boxes stored
+     */
+    template <typename BoxType>
+    size_t Collect(const MultiSampler<BoxType>& boxes) {
+      size_t stored = 0;
+      SmoothingEstimate estimate;
+      for (auto& box : boxes) {
+        if (box->GetSmoothingEstimate(estimate)) {
+          Store(*box, estimate);
+          stored++;
+        }
+      }
+
+      return stored;
+    }
+
+    /**
+     * @brief Replaces the contents of this cache with a saved file.
+     * @return false if the file is missing, malformed, from another version / estimator or for another fingerprint
+     *         (the cache is left empty)
+     */
+    bool Load(const std::string& path) {
+      std::lock_guard<std::mutex> lock(lock_);
+      entries_.clear();
+
+      FILE* file = fopen(path.c_str(), "rb");
+      if (file == nullptr) {
+        return false;
+      }
+
+      Header header;
+      bool ok = (fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == _SMOOTHING_CACHE_MAGIC
+        && header.version == _SMOOTHING_CACHE_VERSION
+        && header.estimator == SmoothingTerrainSampler::GetEstimatorKey()
+        && header.fingerprint == fingerprint_);
+
+      Record record;
+      for (uint64_t i = 0; ok && i < header.count; i++) {
+        if (fread(&record, sizeof(record), 1, file) != 1) {
+          ok = false;
+          break;
+        }
+
+        entries_[record.key] = record.estimate;
+      }
+
+      fclose(file);
+      if (!ok) {
+        entries_.clear();
+      }
+
+      return ok;
+    }
+
+    /**
+     * @brief Writes the cache to a file - via a temp file and a rename, so readers never see half a file.
+     *        Temp names are unique per save, so concurrent savers (threads or processes) don't write over
+     *        each other's temp file - the last rename wins.
+     * @return false if the file couldn't be written
+     */
+    bool Save(const std::string& path) const {
+      std::lock_guard<std::mutex> lock(lock_);
+      std::string temp_path;
+      FILE* file = OpenTempFile(path, temp_path);
+      if (file == nullptr) {
+        return false;
+      }
+
+      Header header;
+      header.magic = _SMOOTHING_CACHE_MAGIC;
+      header.version = _SMOOTHING_CACHE_VERSION;
+      header.estimator = SmoothingTerrainSampler::GetEstimatorKey();
+      header.fingerprint = fingerprint_;
+      header.count = entries_.size();
+
+      bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+      for (auto itr = entries_.begin(); ok && itr != entries_.end(); itr++) {
+        Record record;
+        record.key = itr->first;
+        record.estimate = itr->second;
+        ok = (fwrite(&record, sizeof(record), 1, file) == 1);
+      }
+
+      ok = (fclose(file) == 0) && ok;
+      if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+      }
+
+      return true;
+    }
+
+    /**
+     * @brief Fallback fingerprint - hashes the base sampler's heights at a fixed spread of points.
+     *        Catches most terrain changes, but not ones confined to areas the probes miss.
+     *
+     * @param sampler - base sampler
+     * @param extent - half width of the probed area, around the world origin
+     */
+    template <typename SamplerType>
+    static uint64_t FingerprintSampler(const std::shared_ptr<SamplerType>& sampler, double extent = 4096.0) {
+      // fnv-1a over the height bits
+      uint64_t hash = 0xcbf29ce484222325ULL;
+      for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+          double px = (x / 15.0 * 2.0 - 1.0) * extent;
+          double py = (y / 15.0 * 2.0 - 1.0) * extent;
+          float height = sampler->Sample(px, py);
+          uint32_t bits;
+          memcpy(&bits, &height, sizeof(bits));
+          for (int b = 0; b < 4; b++) {
+            hash ^= (bits >> (b * 8)) & 0xff;
+            hash *= 0x100000001b3ULL;
+          }
+        }
+      }
+
+      return hash;
+    }
+
+   private:
+    // box origin and size, exact
+    struct Key {
+      double origin_x;
+      double origin_y;
+      double size_x;
+      double size_y;
+
+      bool operator==(const Key& other) const {
+        return memcmp(this, &other, sizeof(Key)) == 0;
+      }
+    };
+
+    struct KeyHash {
+      size_t operator()(const Key& key) const {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+        for (size_t i = 0; i < sizeof(Key); i++) {
+          hash ^= bytes[i];
+          hash *= 0x100000001b3ULL;
+        }
+
+        return static_cast<size_t>(hash);
+      }
+    };
+
+    struct Header {
+      uint32_t magic;
+      uint32_t version;
+      uint64_t estimator;
+      uint64_t fingerprint;
+      uint64_t count;
+    };
+
+    struct Record {
+      Key key;
+      SmoothingEstimate estimate;
+    };
+
+    static Key GetKey(const FeatureBox& box) {
+      glm::dvec2 origin = box.GetOrigin();
+      glm::dvec2 size = box.GetSize();
+      // +0.0 so -0.0 and 0.0 share a key
+      return Key { origin.x + 0.0, origin.y + 0.0, size.x + 0.0, size.y + 0.0 };
+    }
+
+    uint64_t fingerprint_;
+    std::unordered_map<Key, SmoothingEstimate, KeyHash> entries_;
+    mutable std::mutex lock_;
+  };
+}
+
+#endif // CG_SMOOTHING_CACHE_H_
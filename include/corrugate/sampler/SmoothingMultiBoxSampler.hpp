@@ -18,7 +18,15 @@ namespace cg {
     // the rest are the same
    public:
     template <typename IterableType>
-    SmoothingMultiBoxSampler(const IterableType& contents) : samplers(contents.begin(), contents.end()), wrap(samplers) {}
+    SmoothingMultiBoxSampler(const IterableType& contents) : samplers(contents), wrap(samplers.data(), samplers.size()) {}
+
+    // borrows boxes - they must outlive the sampler
+    SmoothingMultiBoxSampler(const SmoothingBoxType* const* boxes, size_t count) : samplers(boxes, count), wrap(boxes, count) {}
+
+    // wrap borrows from samplers - point the copy's at its own
+    SmoothingMultiBoxSampler(const SmoothingMultiBoxSampler& other) : samplers(other.samplers), wrap(samplers.data(), samplers.size()) {
+      wrap.SetTileSize(other.wrap.GetTileSize());
+    }
 
     // how does this end up working for samples??
     // - if we just wrap the underlying component, it would be easy
@@ -61,38 +69,19 @@ namespace cg {
       double scale,
       const DataSampler<float>& underlying,
       float* output,
-      size_t n_bytes
+      size_t n_bytes,
+      Workspace* workspace = nullptr
     ) const {
-      size_t elems = sample_dims.x * sample_dims.y;
-      size_t bytes = elems * sizeof(float);
-      if (bytes > n_bytes) {
+      if (static_cast<size_t>(sample_dims.x) * sample_dims.y * sizeof(float) > n_bytes) {
         return 0;
       }
 
-      float* falloffs = new float[sample_dims.x * sample_dims.y];
-      float* temp = new float[sample_dims.x * sample_dims.y];
-      wrap.WriteFalloffSum(origin, sample_dims, scale, falloffs, bytes);
-
-      // first: write height
-
-      // wondering: is there a way to avoid these per-chunk allocs?
-      // - typically, all chunks are the same size - pre-alloc untyped workspace
-      // - swap out as we perform larger operations
-      wrap.WriteHeight(origin, sample_dims, scale, temp, bytes);
-      memcpy(output, temp, bytes);
-      // next: add to output
-
-      DataSampler<float> falloff_sums(sample_dims, falloffs);
-      for (size_t i = 0; i < samplers.size(); i++) {
-        // write weighted smoothing to temp
-        samplers[i]->WriteSmoothDelta(origin, sample_dims, scale, underlying, falloff_sums, temp, bytes);
-        for (size_t c = 0; c < elems; c++) {
-          // add delta to output
-          output[c] += temp[c];
-        }
-      }
+      Workspace& ws = (workspace != nullptr ? *workspace : Workspace::Local());
+      Workspace::Scope scope(ws);
 
-      return bytes;
+      ChunkContext context(origin, sample_dims, scale, ws);
+      PrepareContext(context);
+      return WriteHeight(context, underlying, output, n_bytes);
     }
 
     size_t WriteSplat(
@@ -101,9 +90,10 @@ namespace cg {
       double scale,
       size_t index,
       glm::vec4* output,
-      size_t n_bytes
+      size_t n_bytes,
+      Workspace* workspace = nullptr
     ) const {
-      return wrap.WriteSplat(origin, sample_dims, scale, index, output, n_bytes);
+      return wrap.WriteSplat(origin, sample_dims, scale, index, output, n_bytes, workspace);
     }
 
     size_t WriteTreeFill(
@@ -111,13 +101,130 @@ namespace cg {
       const glm::ivec2& sample_dims,
       double scale,
       float* output,
-      size_t n_bytes
+      size_t n_bytes,
+      Workspace* workspace = nullptr
+    ) const {
+      return wrap.WriteTreeFill(origin, sample_dims, scale, output, n_bytes, workspace);
+    }
+
+    // see MultiBoxSampler::PrepareContext
+    void PrepareContext(ChunkContext& context) const {
+      wrap.PrepareContext(context);
+    }
+
+    size_t WriteHeight(const ChunkContext& context, const DataSampler<float>& underlying, float* output, size_t n_bytes) const {
+      size_t bytes = context.GetElementCount() * sizeof(float);
+      if (bytes > n_bytes) {
+        return 0;
+      }
+
+      // first: write height (straight into output)
+      wrap.WriteHeight(context, output, bytes);
+      // next: add to output
+      AddSmoothDeltas(context, underlying, output);
+      return bytes;
+    }
+
+    /**
+     * @brief Writes every layer in layers.mask in one traversal - see MultiBoxSampler::WriteLayers.
+     *        Height gets smoothing deltas added, using underlying.
+     */
+    size_t WriteLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      const DataSampler<float>& underlying,
+      const ChunkLayers& layers,
+      Workspace* workspace = nullptr
     ) const {
-      return wrap.WriteTreeFill(origin, sample_dims, scale, output, n_bytes);
+      Workspace& ws = (workspace != nullptr ? *workspace : Workspace::Local());
+      Workspace::Scope scope(ws);
+
+      ChunkContext context(origin, sample_dims, scale, ws);
+      PrepareContext(context);
+      return WriteLayers(context, underlying, layers);
+    }
+
+    size_t WriteLayers(const ChunkContext& context, const DataSampler<float>& underlying, const ChunkLayers& layers) const {
+      size_t bytes = wrap.WriteLayers(context, layers);
+      if (layers.Has(LAYER_HEIGHT)) {
+        AddSmoothDeltas(context, underlying, layers.height);
+      }
+
+      return bytes;
+    }
+
+    /**
+     * @brief Quantized WriteLayers - see MultiBoxSampler::WriteLayers.
+     *        Smoothing deltas cover the whole chunk, so height is composited as floats first and quantized after
+     *        (the other layers are quantized per block as usual).
+     */
+    size_t WriteLayers(
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      const DataSampler<float>& underlying,
+      const QuantizedChunkLayers& layers,
+      Workspace* workspace = nullptr
+    ) const {
+      Workspace& ws = (workspace != nullptr ? *workspace : Workspace::Local());
+      Workspace::Scope scope(ws);
+
+      ChunkContext context(origin, sample_dims, scale, ws);
+      PrepareContext(context);
+      return WriteLayers(context, underlying, layers);
+    }
+
+    size_t WriteLayers(const ChunkContext& context, const DataSampler<float>& underlying, const QuantizedChunkLayers& layers) const {
+      if (!layers.Has(LAYER_HEIGHT)) {
+        return wrap.WriteLayers(context, layers);
+      }
+
+      QuantizedChunkLayers rest = layers;
+      rest.mask &= ~LAYER_HEIGHT;
+      size_t bytes = (rest.mask != 0 ? wrap.WriteLayers(context, rest) : 0);
+
+      size_t elems = context.GetElementCount();
+      Workspace& ws = context.GetWorkspace();
+      Workspace::Scope scope(ws);
+
+      float* height = ws.Allocate<float>(elems);
+      WriteHeight(context, underlying, height, elems * sizeof(float));
+      layers.QuantizeHeight(height, static_cast<int>(elems), layers.height);
+      return bytes + elems * sizeof(uint16_t);
+    }
+
+    size_t WriteSplat(const ChunkContext& context, size_t index, glm::vec4* output, size_t n_bytes) const {
+      return wrap.WriteSplat(context, index, output, n_bytes);
+    }
+
+    size_t WriteTreeFill(const ChunkContext& context, float* output, size_t n_bytes) const {
+      return wrap.WriteTreeFill(context, output, n_bytes);
     }
    private:
-    std::vector<std::shared_ptr<const SmoothingBoxType>> samplers;
+    const BoxSpan<SmoothingBoxType> samplers;
     MultiBoxSampler<SmoothingBoxType> wrap;
+
+    void AddSmoothDeltas(const ChunkContext& context, const DataSampler<float>& underlying, float* output) const {
+      CG_METRIC_STAGE(STAGE_SMOOTH);
+      size_t elems = context.GetElementCount();
+      size_t bytes = elems * sizeof(float);
+
+      Workspace& ws = context.GetWorkspace();
+      Workspace::Scope scope(ws);
+
+      float* temp = ws.Allocate<float>(elems);
+
+      DataSampler<float> falloff_sums = context.GetFalloffSampler();
+      for (size_t i = 0; i < samplers.size(); i++) {
+        // write weighted smoothing to temp
+        samplers[i]->WriteSmoothDelta(context.origin, context.sample_dims, context.scale, underlying, falloff_sums, temp, bytes, ws);
+        for (size_t c = 0; c < elems; c++) {
+          // add delta to output
+          output[c] += temp[c];
+        }
+      }
+    }
   };
 }
 
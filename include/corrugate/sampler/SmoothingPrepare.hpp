@@ -0,0 +1,81 @@
+#ifndef CG_SMOOTHING_PREPARE_H_
+#define CG_SMOOTHING_PREPARE_H_
+
+#include "corrugate/MultiSampler.hpp"
+#include "corrugate/sampler/SmoothingCache.hpp"
+#include "corrugate/util/ThreadPool.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cg {
+  // (prepared, total) - prepared counts up to total, one call per box
+  typedef std::function<void(size_t, size_t)> PrepareProgress;
+
+  /**
+   * @brief Prepares the smoothing cache of every box in a multisampler, spread across a pool.
+   *        Boxes which are already prepared are skipped. Each box still locks its own cache,
+   *        so this is safe to run alongside lazy PrepareCache calls.
+   *
+   * @param boxes - smoothing boxes (anything with PrepareCache / IsCachePrepared)
+   * @param base_sampler - sampler the smoothing estimate reads from (bulk WriteHeight used if present)
+   * @param pool - pool to run on (the calling thread helps out, and returns once every box is done)
+   * @param progress - called from pool threads, one call at a time, as boxes finish
+   * @return size_t - number of boxes prepared by this call
+   */
+  template <typename BoxType, typename BaseType>
+  size_t PrepareAll(
+    const MultiSampler<BoxType>& boxes,
+    const std::shared_ptr<BaseType>& base_sampler,
+    ThreadPool& pool,
+    const PrepareProgress& progress = nullptr
+  ) {
+    std::vector<std::shared_ptr<BoxType>> pending;
+    for (auto& box : boxes) {
+      if (!box->IsCachePrepared()) {
+        pending.push_back(box);
+      }
+    }
+
+    std::mutex progress_lock;
+    size_t prepared = 0;
+
+    pool.ParallelFor(pending.size(), [&](size_t i) {
+      pending[i]->PrepareCache(base_sampler);
+      if (progress) {
+        std::lock_guard<std::mutex> lock(progress_lock);
+        progress(++prepared, pending.size());
+      }
+    });
+
+    return pending.size();
+  }
+
+  /**
+   * @brief PrepareAll, but boxes with an estimate in cache are seeded from it instead of computed,
+   *        and freshly computed estimates are added to cache (save it afterwards to keep them).
+   *
+   * @return size_t - number of boxes which had to be computed
+   */
+  template <typename BoxType, typename BaseType>
+  size_t PrepareAll(
+    const MultiSampler<BoxType>& boxes,
+    const std::shared_ptr<BaseType>& base_sampler,
+    ThreadPool& pool,
+    SmoothingCache& cache,
+    const PrepareProgress& progress = nullptr
+  ) {
+    cache.Apply(boxes);
+    size_t prepared = PrepareAll(boxes, base_sampler, pool, progress);
+    if (prepared > 0) {
+      cache.Collect(boxes);
+    }
+
+    return prepared;
+  }
+}
+
+#endif // CG_SMOOTHING_PREPARE_H_
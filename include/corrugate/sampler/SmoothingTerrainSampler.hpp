@@ -2,11 +2,28 @@
 #define SMOOTHING_TERRAIN_SAMPLER_H_
 
 #include "corrugate/FeatureBox.hpp"
+#include "corrugate/traits/chunk_write_trait.hpp"
+#include "corrugate/util/Workspace.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <mutex>
 
+// 64x64 equiv (could probably decrease further)
+#ifndef _HAMMERSLEY_SAMPLES
+#define _HAMMERSLEY_SAMPLES 4096U
+#endif
+
 namespace cg {
+  // what CalculateOrigin works out for a box - deterministic given the box and the base sampler
+  struct SmoothingEstimate {
+    double height_origin = 0.0;
+    double slope_factor = 0.0;
+  };
+
   class SmoothingTerrainSampler {
     // lazy init origin here still? thinking so
    public:
@@ -21,6 +38,54 @@ namespace cg {
       CalculateOrigin(sampler);
     }
 
+    /**
+     * @brief Identifies the estimator - changes whenever CalculateOrigin would work out something different
+     *        from the same terrain (point count, step, max slope, or the method itself).
+     *        SmoothingCache files record it, so estimates from another estimator aren't reused.
+     */
+    static uint64_t GetEstimatorKey() {
+      // fnv-1a over the parameters
+      uint64_t params[4];
+      params[0] = ESTIMATOR_REVISION;
+      params[1] = _HAMMERSLEY_SAMPLES;
+      memcpy(&params[2], &GRADIENT_STEP, sizeof(double));
+      memcpy(&params[3], &MAX_SLOPE, sizeof(double));
+
+      uint64_t hash = 0xcbf29ce484222325ULL;
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(params);
+      for (size_t i = 0; i < sizeof(params); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+      }
+
+      return hash;
+    }
+
+    bool IsCachePrepared() const {
+      std::lock_guard<std::mutex> lock(cache_lock_);
+      return cached_;
+    }
+
+    // false if the cache isn't prepared yet
+    bool GetEstimate(SmoothingEstimate& output) const {
+      std::lock_guard<std::mutex> lock(cache_lock_);
+      if (!cached_) {
+        return false;
+      }
+
+      output.height_origin = height_origin;
+      output.slope_factor = secret_smoothing_factor;
+      return true;
+    }
+
+    // seeds the cache with a stored estimate (see SmoothingCache) - PrepareCache becomes a no-op
+    void SetEstimate(const SmoothingEstimate& estimate) {
+      std::lock_guard<std::mutex> lock(cache_lock_);
+      height_origin = estimate.height_origin;
+      secret_smoothing_factor = estimate.slope_factor;
+      cached_ = true;
+    }
+
 
     double Smooth(double input) const {
 
@@ -41,6 +106,10 @@ namespace cg {
     double smoothing_factor = 0.0;
    private:
     static constexpr double MAX_SLOPE = 0.09;
+    // gradient step, as a fraction of the spacing between points
+    static constexpr double GRADIENT_STEP = 0.5;
+    // bump when the way points / gradients are taken changes
+    static constexpr uint64_t ESTIMATOR_REVISION = 3;
     mutable double height_origin = 0.0;
     mutable double secret_smoothing_factor = 0.0;
     mutable bool cached_ = false;
@@ -70,12 +139,18 @@ namespace cg {
       return x;
     }
 
-    // 64x64 equiv (could probably decrease further)
-    #define _HAMMERSLEY_SAMPLES 4096U
-
     // handled all at once by some chunk - estimates a height origin from contained samples
-    #define EPSILON 0.001
-    #define INV_EPSILON (1.0 / EPSILON)
+    // grid step is GRADIENT_STEP of the spacing between points, rather than a fixed epsilon:
+    // differences over a tiny step turn float heights into quantization noise
+    double GetGradientStep() const {
+      glm::dvec2 size = box_.GetSize();
+      return GRADIENT_STEP * std::sqrt(std::max(size.x * size.y, 0.000001) / _HAMMERSLEY_SAMPLES);
+    }
+
+    // estimates read heights off a grid of nodes step apart, covering the box (at least one cell) plus a one node border
+    glm::ivec2 GetGridDims(double step) const {
+      return glm::max(glm::ivec2(glm::ceil(box_.GetSize() / step)), glm::ivec2(1)) + glm::ivec2(3);
+    }
 
     template <typename US>
     void CalculateOrigin(const std::shared_ptr<US>& base_sampler) const {
@@ -85,28 +160,73 @@ namespace cg {
         return;
       }
 
+      double step = GetGradientStep();
+      glm::ivec2 dims = GetGridDims(step);
+      glm::dvec2 grid_origin = box_.GetOrigin() - glm::dvec2(step);
+      size_t elems = static_cast<size_t>(dims.x) * dims.y;
+
+      Workspace& ws = Workspace::Local();
+      Workspace::Scope scope(ws);
+      float* heights = ws.Allocate<float>(elems);
+
+      // one chunk write where the base sampler has one, otherwise a sample per node - same grid either way
+      if constexpr (trait::height_chunk_trait<US>::value) {
+        base_sampler->WriteHeight(grid_origin, dims, step, heights, elems * sizeof(float));
+      } else {
+        for (int y = 0; y < dims.y; y++) {
+          for (int x = 0; x < dims.x; x++) {
+            heights[static_cast<size_t>(y) * dims.x + x] = static_cast<float>(base_sampler->Sample(grid_origin.x + x * step, grid_origin.y + y * step));
+          }
+        }
+      }
+
       double height_sum = 0.0;
+      double max_slope = 0.00001;
+      EstimateFromGrid(heights, dims, step, height_sum, max_slope);
+
+      // safe keeping for now
+      secret_smoothing_factor = 1.0 - (MAX_SLOPE / max_slope);
+      height_origin = height_sum;
+      cached_ = true;
+    }
+
+    // heights / gradients at each hammersley point, interpolated from the four nodes around it
+    // - gradients are central differences at the nodes (over 2 * step, in double)
+    void EstimateFromGrid(const float* heights, const glm::ivec2& dims, double step, double& height_sum, double& max_slope) const {
       glm::dvec2 origin = box_.GetOrigin();
       glm::dvec2 size   = box_.GetSize();
-      double max_slope = 0.00001;
+      double inv_step = 0.5 / step;
+      glm::ivec2 nodes = dims - glm::ivec2(2);
+
+      // node (x, y), x / y from -1 (border) to nodes
+      auto node = [&](int x, int y) {
+        return static_cast<double>(heights[static_cast<size_t>(y + 1) * dims.x + (x + 1)]);
+      };
+
       for (unsigned int i = 0; i < _HAMMERSLEY_SAMPLES; i++) {
-        glm::dvec2 point = GetHammersley(i, _HAMMERSLEY_SAMPLES, origin, size);
-        double height = base_sampler->Sample(point.x, point.y);
-        double grad_x = (base_sampler->Sample(point.x + EPSILON, point.y) - height) * INV_EPSILON;
-        double grad_y = (base_sampler->Sample(point.x, point.y + EPSILON) - height) * INV_EPSILON;
-        max_slope = std::max(std::sqrt(grad_x * grad_x + grad_y * grad_y), max_slope);
+        glm::dvec2 local = (GetHammersley(i, _HAMMERSLEY_SAMPLES, origin, size) - origin) / step;
+        glm::ivec2 cell = glm::clamp(glm::ivec2(glm::floor(local)), glm::ivec2(0), nodes - glm::ivec2(2));
+        glm::dvec2 t = local - glm::dvec2(cell);
+
+        double height = 0.0;
+        double grad_x = 0.0;
+        double grad_y = 0.0;
+        for (int dy = 0; dy < 2; dy++) {
+          for (int dx = 0; dx < 2; dx++) {
+            int x = cell.x + dx;
+            int y = cell.y + dy;
+            double weight = (dx ? t.x : 1.0 - t.x) * (dy ? t.y : 1.0 - t.y);
+            height += weight * node(x, y);
+            grad_x += weight * (node(x + 1, y) - node(x - 1, y)) * inv_step;
+            grad_y += weight * (node(x, y + 1) - node(x, y - 1)) * inv_step;
+          }
+        }
 
-        // two free samples :3
+        max_slope = std::max(std::sqrt(grad_x * grad_x + grad_y * grad_y), max_slope);
         height_sum += height / static_cast<double>(_HAMMERSLEY_SAMPLES);
         // tba: calculate gradient samples as well, to get a rough estimate of max height
         // add opt. parameter for "max slope"
-
       }
-
-      // safe keeping for now
-      secret_smoothing_factor = 1.0 - (MAX_SLOPE / max_slope);
-      height_origin = height_sum;
-      cached_ = true;
     }
   };
 }
@@ -0,0 +1,59 @@
+#ifndef STATIC_TERRAIN_SAMPLER_H_
+#define STATIC_TERRAIN_SAMPLER_H_
+
+#include "corrugate/sampler/impl/ChunkWriteDelegate.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+
+namespace cg {
+  // BaseTerrainSampler, but with the sampler types as template params
+  // - no virtual call per sample, so the chunk loops can inline Sample (and vectorize, if it's simple enough)
+  // - use BaseTerrainSampler when boxes with different sampler types need to share a collection
+  template <typename HeightType, typename SplatType, typename TreeFillType>
+  class StaticTerrainSampler {
+   public:
+    StaticTerrainSampler(
+      std::shared_ptr<HeightType> heightmap,
+      std::shared_ptr<SplatType> splat,
+      std::shared_ptr<TreeFillType> tree_fill
+    ) : height_(heightmap), splat_(splat), tree_fill_(tree_fill) {}
+
+    float SampleHeight(double x, double y) const {
+      return height_->Sample(x, y);
+    }
+
+    glm::vec4 SampleSplat(double x, double y, size_t index) const {
+      return splat_->Sample(x, y, index);
+    }
+
+    float SampleTreeFill(double x, double y) const {
+      return tree_fill_->Sample(x, y);
+    }
+
+    // bulk writers on the samplers are used if present - see impl::HeightChunkWriteDelegate
+    size_t WriteHeight(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) const {
+      return impl::HeightChunkWriteDelegate<HeightType>::Write(*height_, origin, sample_dims, scale, output, n_bytes);
+    }
+
+    size_t WriteSplat(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t index, glm::vec4* output, size_t n_bytes) const {
+      return impl::SplatChunkWriteDelegate<SplatType>::Write(splat_, origin, sample_dims, scale, index, output, n_bytes);
+    }
+
+    size_t WriteSplatLayers(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t first_index, size_t count, glm::vec4* output, size_t n_bytes) const {
+      return impl::SplatLayersChunkWriteDelegate<SplatType>::Write(splat_, origin, sample_dims, scale, first_index, count, output, n_bytes);
+    }
+
+    size_t WriteTreeFill(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) const {
+      return impl::TreeFillChunkWriteDelegate<TreeFillType>::Write(*tree_fill_, origin, sample_dims, scale, output, n_bytes);
+    }
+
+   private:
+    std::shared_ptr<HeightType> height_;
+    std::shared_ptr<SplatType> splat_;
+    std::shared_ptr<TreeFillType> tree_fill_;
+  };
+}
+
+#endif // STATIC_TERRAIN_SAMPLER_H_
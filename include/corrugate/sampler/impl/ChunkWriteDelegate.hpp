@@ -0,0 +1,147 @@
+#ifndef CHUNK_WRITE_DELEGATE_H_
+#define CHUNK_WRITE_DELEGATE_H_
+
+#include "corrugate/sampler/SingleIndexSplatManager.hpp"
+#include "corrugate/traits/chunk_write_trait.hpp"
+#include "corrugate/util/Metrics.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <type_traits>
+
+// picks between a sampler's own bulk writer and the per-sample loop
+// - same idea as SingleSplatChunkWriteDelegate, for chunk writes inside boxes
+namespace cg {
+  namespace impl {
+    template <typename DataType, typename SamplerType>
+    size_t WriteSamples(
+      SamplerType& sampler,
+      const glm::dvec2& origin,
+      const glm::ivec2& sample_dims,
+      double scale,
+      DataType* output,
+      size_t n_bytes
+    ) {
+      size_t required_space = static_cast<size_t>(sample_dims.x) * sample_dims.y * sizeof(DataType);
+      if (required_space > n_bytes) {
+        return 0;
+      }
+
+      // side note: for splats we need to adjust by 0.5
+      for (int y = 0; y < sample_dims.y; y++) {
+        double pos_y = origin.y + y * scale;
+        DataType* row = output + static_cast<size_t>(y) * sample_dims.x;
+        for (int x = 0; x < sample_dims.x; x++) {
+          row[x] = sampler.Sample(origin.x + x * scale, pos_y);
+        }
+      }
+
+      return required_space;
+    }
+
+    // no bulk writer - sample one at a time
+    template <typename DataType, typename SamplerType>
+    struct SampleChunkWriteDelegate {
+      static size_t Write(SamplerType& sampler, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, DataType* output, size_t n_bytes) {
+        return WriteSamples<DataType>(sampler, origin, sample_dims, scale, output, n_bytes);
+      }
+    };
+
+    template <typename SamplerType, typename Enable = void>
+    struct HeightChunkWriteDelegate {
+      static size_t Write(SamplerType& sampler, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) {
+        CG_METRIC_ADD(COUNTER_HEIGHT_SINGLE, 1);
+        return WriteSamples<float>(sampler, origin, sample_dims, scale, output, n_bytes);
+      }
+    };
+
+    // specialization if height chunk write supported
+    template <typename SamplerType>
+    struct HeightChunkWriteDelegate<
+      SamplerType,
+      typename std::enable_if_t<trait::height_chunk_trait<SamplerType>::value>
+    > {
+      static size_t Write(SamplerType& sampler, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) {
+        CG_METRIC_ADD(COUNTER_HEIGHT_BULK, 1);
+        return sampler.WriteHeight(origin, sample_dims, scale, output, n_bytes);
+      }
+    };
+
+    template <typename SamplerType, typename Enable = void>
+    struct TreeFillChunkWriteDelegate {
+      static size_t Write(SamplerType& sampler, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) {
+        CG_METRIC_ADD(COUNTER_TREE_FILL_SINGLE, 1);
+        return WriteSamples<float>(sampler, origin, sample_dims, scale, output, n_bytes);
+      }
+    };
+
+    // specialization if tree fill chunk write supported
+    template <typename SamplerType>
+    struct TreeFillChunkWriteDelegate<
+      SamplerType,
+      typename std::enable_if_t<trait::tree_fill_chunk_trait<SamplerType>::value>
+    > {
+      static size_t Write(SamplerType& sampler, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) {
+        CG_METRIC_ADD(COUNTER_TREE_FILL_BULK, 1);
+        return sampler.WriteTreeFill(origin, sample_dims, scale, output, n_bytes);
+      }
+    };
+
+    // splat: no bulk writer - sample one index at a time
+    template <typename SplatType, typename Enable = void>
+    struct SplatChunkWriteDelegate {
+      static size_t Write(const std::shared_ptr<SplatType>& splat, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t index, glm::vec4* output, size_t n_bytes) {
+        CG_METRIC_ADD(COUNTER_SPLAT_SINGLE, 1);
+        SingleIndexSplatManager<SplatType> single(splat, index);
+        return WriteSamples<glm::vec4>(single, origin, sample_dims, scale, output, n_bytes);
+      }
+    };
+
+    // specialization if splat chunk write supported
+    template <typename SplatType>
+    struct SplatChunkWriteDelegate<
+      SplatType,
+      typename std::enable_if_t<trait::splat_chunk_trait<SplatType>::value>
+    > {
+      static size_t Write(const std::shared_ptr<SplatType>& splat, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t index, glm::vec4* output, size_t n_bytes) {
+        CG_METRIC_ADD(COUNTER_SPLAT_BULK, 1);
+        return splat->WriteSplat(origin, sample_dims, scale, index, output, n_bytes);
+      }
+    };
+
+    // splat layers: no layered writer - one index at a time, planes back to back
+    template <typename SplatType, typename Enable = void>
+    struct SplatLayersChunkWriteDelegate {
+      static size_t Write(const std::shared_ptr<SplatType>& splat, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t first_index, size_t count, glm::vec4* output, size_t n_bytes) {
+        size_t plane_elems = static_cast<size_t>(sample_dims.x) * sample_dims.y;
+        size_t plane_bytes = plane_elems * sizeof(glm::vec4);
+        if (plane_bytes * count > n_bytes) {
+          return 0;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+          if (SplatChunkWriteDelegate<SplatType>::Write(splat, origin, sample_dims, scale, first_index + i, output + i * plane_elems, plane_bytes) != plane_bytes) {
+            return 0;
+          }
+        }
+
+        return plane_bytes * count;
+      }
+    };
+
+    // specialization if layered splat write supported
+    template <typename SplatType>
+    struct SplatLayersChunkWriteDelegate<
+      SplatType,
+      typename std::enable_if_t<trait::splat_layers_chunk_trait<SplatType>::value>
+    > {
+      static size_t Write(const std::shared_ptr<SplatType>& splat, const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t first_index, size_t count, glm::vec4* output, size_t n_bytes) {
+        CG_METRIC_ADD(COUNTER_SPLAT_LAYERS_BULK, 1);
+        return splat->WriteSplatLayers(origin, sample_dims, scale, first_index, count, output, n_bytes);
+      }
+    };
+  }
+}
+
+#endif // CHUNK_WRITE_DELEGATE_H_
@@ -1,12 +1,15 @@
 #ifndef I_SPLAT_MANAGER_H_
 #define I_SPLAT_MANAGER_H_
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
 #include <glm/glm.hpp>
 
 #include "corrugate/sampler/splat/impl/SplatWriterImpl.hpp"
+#include "corrugate/simd/Interleave.hpp"
+#include "corrugate/util/Workspace.hpp"
 
 // tba: deprecate impl in terraingen in favor of this
 // (why is this here? because it helps w creating boxes!)
@@ -60,7 +63,7 @@ namespace cg {
     // thinking: pass in number of samplers to pull, for consistency (don't write if not avail)
 
     bool HasSampler(size_t splat_index) const {
-      return splat_index >= 0 && splat_index < writers_.capacity() && writers_[splat_index] != nullptr;
+      return splat_index < writers_.size() && writers_[splat_index] != nullptr;
     }
 
     int GetLayerCount() const { return writers_.size(); }
@@ -84,6 +87,63 @@ namespace cg {
       return true;
     }
 
+    /**
+     * @brief Writes splat contents as four channel planes (r, g, b, a) instead of interleaved rgba.
+     *        Use simd::Interleave4 to get rgba back, if needed.
+     *
+     * @param size - size of output, in px
+     * @param offset - offset applied to bottom left corner of image
+     * @param scale - distance between pixel samples
+     * @param output - four planes back to back, size.x * size.y floats each
+     * @param splat_index - splat index to sample from
+     */
+    bool WriteSamplerPlanar(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output, size_t splat_index) const {
+      if (!HasSampler(splat_index)) {
+        return false;
+      }
+
+      writers_[splat_index]->WritePlanar(size, offset, scale, output);
+      return true;
+    }
+
+    /**
+     * @brief Writes a range of splat layers in one pass.
+     *        Samplers bound to more than one layer (or channel) are only evaluated once per pixel.
+     *
+     * @param size - size of each layer, in px
+     * @param offset - offset applied to bottom left corner of image
+     * @param scale - distance between pixel samples
+     * @param output - layers back to back, size.x * size.y * 4 floats each
+     * @param first_index - first splat index to write
+     * @param count - number of layers to write
+     * @return true if every layer had a sampler - missing layers are zeroed
+     */
+    bool WriteSamplers(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output, size_t first_index, size_t count) const {
+      // sample pixel centers, same as WriteSampler
+      return WriteLayers(size, offset + scale * 0.5, scale, output, first_index, count);
+    }
+
+    // writes every bound layer - see WriteSamplers
+    bool WriteAllSamplers(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output) const {
+      return WriteSamplers(size, offset, scale, output, 0, writers_.size());
+    }
+
+    // chunk writers, so boxes can bulk write from a splat manager (samples line up with Sample)
+
+    size_t WriteSplat(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t index, glm::vec4* output, size_t n_bytes) const {
+      return WriteSplatLayers(origin, sample_dims, scale, index, 1, output, n_bytes);
+    }
+
+    size_t WriteSplatLayers(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t first_index, size_t count, glm::vec4* output, size_t n_bytes) const {
+      size_t bytes = static_cast<size_t>(sample_dims.x) * sample_dims.y * count * sizeof(glm::vec4);
+      if (bytes > n_bytes) {
+        return 0;
+      }
+
+      WriteLayers(sample_dims, origin, glm::dvec2(scale), reinterpret_cast<float*>(output), first_index, count);
+      return bytes;
+    }
+
     glm::vec4 Sample(double x, double y, size_t index) const {
       if (!HasSampler(index)) {
         return glm::vec4(0);
@@ -95,6 +155,91 @@ namespace cg {
     // tba: write a simple "splat test" which just puts some sample data in an image
 
    private:
+    // start is the position of the first sample
+    bool WriteLayers(const glm::ivec2& size, const glm::dvec2& start, const glm::dvec2& scale, float* output, size_t first_index, size_t count) const {
+      size_t row_floats = static_cast<size_t>(size.x) * 4;
+      size_t plane_floats = row_floats * size.y;
+
+      Workspace& ws = Workspace::Local();
+      Workspace::Scope scope(ws);
+
+      // channel -> unique sampler row, for layers whose channels can be split (-1 otherwise)
+      int* channel_rows = ws.Allocate<int>(count * 4);
+      // unique samplers
+      const void** keys = ws.Allocate<const void*>(count * 4);
+      const impl::SplatWriter** row_writers = ws.Allocate<const impl::SplatWriter*>(count * 4);
+      size_t* row_channels = ws.Allocate<size_t>(count * 4);
+      size_t unique_count = 0;
+
+      bool all_bound = true;
+      for (size_t i = 0; i < count; i++) {
+        size_t index = first_index + i;
+        int* layer_rows = channel_rows + i * 4;
+        std::fill(layer_rows, layer_rows + 4, -1);
+        if (!HasSampler(index)) {
+          all_bound = false;
+          continue;
+        }
+
+        const void* layer_keys[4];
+        if (writers_[index]->GetChannelKeys(layer_keys) != 4) {
+          continue;
+        }
+
+        for (size_t c = 0; c < 4; c++) {
+          size_t u = 0;
+          while (u < unique_count && keys[u] != layer_keys[c]) {
+            u++;
+          }
+
+          if (u == unique_count) {
+            keys[u] = layer_keys[c];
+            row_writers[u] = writers_[index].get();
+            row_channels[u] = c;
+            unique_count++;
+          }
+
+          layer_rows[c] = static_cast<int>(u);
+        }
+      }
+
+      float* rows = ws.Allocate<float>(unique_count * size.x);
+
+      glm::dvec2 row_start = start;
+      for (int y = 0; y < size.y; y++) {
+        row_start.y = start.y + scale.y * y;
+
+        // each unique sampler once
+        for (size_t u = 0; u < unique_count; u++) {
+          row_writers[u]->WriteChannelRow(row_channels[u], row_start, scale.x, size.x, rows + u * size.x);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+          size_t index = first_index + i;
+          float* out_row = output + i * plane_floats + static_cast<size_t>(y) * row_floats;
+          const int* layer_rows = channel_rows + i * 4;
+
+          if (!HasSampler(index)) {
+            std::fill(out_row, out_row + row_floats, 0.0f);
+          } else if (layer_rows[0] < 0) {
+            writers_[index]->WriteRow(row_start, scale.x, size.x, out_row);
+          } else {
+            // interleave channels
+            simd::Interleave4(
+              rows + static_cast<size_t>(layer_rows[0]) * size.x,
+              rows + static_cast<size_t>(layer_rows[1]) * size.x,
+              rows + static_cast<size_t>(layer_rows[2]) * size.x,
+              rows + static_cast<size_t>(layer_rows[3]) * size.x,
+              size.x,
+              out_row
+            );
+          }
+        }
+      }
+
+      return all_bound;
+    }
+
     void EnsureCapacity(size_t splat_index) {
       if (writers_.size() < (splat_index + 1)) {
         writers_.resize(splat_index + 1);
@@ -1,6 +1,9 @@
 #ifndef SPLAT_WRITER_H_
 #define SPLAT_WRITER_H_
 
+#include "corrugate/simd/Interleave.hpp"
+#include "corrugate/util/Workspace.hpp"
+
 #include <glm/glm.hpp>
 
 namespace cg {
@@ -17,6 +20,45 @@ namespace cg {
        */
       virtual void Write(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output) const = 0;
       virtual glm::vec4 Sample(double x, double y) = 0;
+
+      /**
+       * @brief Writes writer's contents as four channel planes (r, then g, b, a) instead of rgba.
+       *        Default writes rgba and splits it - override to write each plane directly.
+       *
+       * @param size - size of output image
+       * @param offset - offset applied to samplers
+       * @param scale - distance between pixels
+       * @param output - output for planes (size.x * size.y floats each)
+       */
+      virtual void WritePlanar(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output) const {
+        size_t plane = static_cast<size_t>(size.x) * size.y;
+
+        Workspace& ws = Workspace::Local();
+        Workspace::Scope scope(ws);
+        float* rgba = ws.Allocate<float>(plane * 4);
+
+        Write(size, offset, scale, rgba);
+        simd::Deinterleave4(rgba, static_cast<int>(plane), output, output + plane, output + plane * 2, output + plane * 3);
+      }
+
+      /**
+       * @brief Writes one row of rgba samples.
+       *
+       * @param start - position of the first sample
+       * @param step - x distance between samples
+       * @param count - number of samples
+       * @param output - interleaved rgba output (count * 4 floats)
+       */
+      virtual void WriteRow(const glm::dvec2& start, double step, int count, float* output) const = 0;
+
+      // layered writes: if each channel has its own sampler, expose them so samplers shared between layers
+      // are only evaluated once. keys identify the bound sampler objects - returns 4, or 0 if channels can't be split.
+      virtual size_t GetChannelKeys(const void**) const {
+        return 0;
+      }
+
+      // writes one channel of a row (count floats) - only called if GetChannelKeys returned 4
+      virtual void WriteChannelRow(size_t, const glm::dvec2&, double, int, float*) const {}
       virtual ~SplatWriter() {}
     };
   }
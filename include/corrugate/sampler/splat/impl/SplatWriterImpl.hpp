@@ -10,8 +10,7 @@
 
 #include "corrugate/sampler/splat/impl/SplatWriter.hpp"
 #include "corrugate/traits/chunk_write_trait.hpp"
-
-#include <gog43/Logger.hpp>
+#include "corrugate/util/Metrics.hpp"
 
 namespace cg {
   namespace impl {
@@ -25,7 +24,7 @@ namespace cg {
       ) : splat(splat), index(index) {}
 
       void Write(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output) const {
-        gog43::print("using single write :/");
+        CG_METRIC_ADD(COUNTER_SPLAT_SINGLE, 1);
         glm::vec4* wptr = reinterpret_cast<glm::vec4*>(output);
         glm::dvec2 sample_pos;
         glm::dvec2 half_scale = scale * 0.5;
@@ -60,7 +59,7 @@ namespace cg {
       ) : splat(splat), index(index) {}
 
       void Write(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output) const {
-        gog43::print("using bulk write!");
+        CG_METRIC_ADD(COUNTER_SPLAT_BULK, 1);
         splat->WriteSplat(
           offset,
           size,
@@ -76,6 +75,33 @@ namespace cg {
     };
 
 
+    // single channel writes - per sample, unless the sampler can write an image itself
+    template <typename Sampler, typename Enable = void>
+    struct ChannelChunkWriteDelegate {
+      static void Write(const Sampler& sampler, const glm::ivec2& size, const glm::dvec2& start, const glm::dvec2& scale, float* output) {
+        CG_METRIC_ADD(COUNTER_CHANNEL_SINGLE, 1);
+        for (int y = 0; y < size.y; ++y) {
+          double sample_y = start.y + scale.y * y;
+          float* row = output + static_cast<size_t>(y) * size.x;
+          for (int x = 0; x < size.x; ++x) {
+            row[x] = sampler.Sample(start.x + scale.x * x, sample_y);
+          }
+        }
+      }
+    };
+
+    // specialization if channel chunk write supported
+    template <typename Sampler>
+    struct ChannelChunkWriteDelegate<
+      Sampler,
+      typename std::enable_if_t<trait::channel_chunk_trait<Sampler>::value>
+    > {
+      static void Write(const Sampler& sampler, const glm::ivec2& size, const glm::dvec2& start, const glm::dvec2& scale, float* output) {
+        CG_METRIC_ADD(COUNTER_CHANNEL_BULK, 1);
+        sampler.Write(size, start, scale, output);
+      }
+    };
+
     template <typename Splat, typename Enable = void>
     class SingleSplatWriter : public SplatWriter {
      public:
@@ -92,6 +118,13 @@ namespace cg {
       glm::vec4 Sample(double x, double y) override {
         return splat->Sample(x, y, index);
       }
+
+      void WriteRow(const glm::dvec2& start, double step, int count, float* output) const override {
+        glm::vec4* wptr = reinterpret_cast<glm::vec4*>(output);
+        for (int x = 0; x < count; ++x) {
+          wptr[x] = splat->Sample(start.x + step * x, start.y, index);
+        }
+      }
      private:
       std::shared_ptr<Splat> splat;
       size_t index;
@@ -118,7 +151,7 @@ namespace cg {
         const std::shared_ptr<sG>& g,
         const std::shared_ptr<sB>& b,
         const std::shared_ptr<sA>& a
-      ) : sampler_r(*r), sampler_g(*g), sampler_b(*b), sampler_a(*a) {}
+      ) : sampler_r(*r), sampler_g(*g), sampler_b(*b), sampler_a(*a), keys{ r.get(), g.get(), b.get(), a.get() } {}
       void Write(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output) const override {
         float* wptr = output;
         glm::dvec2 sample_pos;
@@ -145,11 +178,63 @@ namespace cg {
           sampler_a.Sample(x, y)
         );
       }
+
+      void WriteRow(const glm::dvec2& start, double step, int count, float* output) const override {
+        float* wptr = output;
+        for (int x = 0; x < count; ++x) {
+          double sample_x = start.x + step * x;
+          *wptr++ = sampler_r.Sample(sample_x, start.y);
+          *wptr++ = sampler_g.Sample(sample_x, start.y);
+          *wptr++ = sampler_b.Sample(sample_x, start.y);
+          *wptr++ = sampler_a.Sample(sample_x, start.y);
+        }
+      }
+
+      // one pass per channel - each sampler's working set stays hot, and bulk channel writers get a whole plane
+      void WritePlanar(const glm::ivec2& size, const glm::dvec2& offset, const glm::dvec2& scale, float* output) const override {
+        size_t plane = static_cast<size_t>(size.x) * size.y;
+        // pixel centers, same as Write
+        glm::dvec2 start = offset + scale * 0.5;
+        ChannelChunkWriteDelegate<sR>::Write(sampler_r, size, start, scale, output);
+        ChannelChunkWriteDelegate<sG>::Write(sampler_g, size, start, scale, output + plane);
+        ChannelChunkWriteDelegate<sB>::Write(sampler_b, size, start, scale, output + plane * 2);
+        ChannelChunkWriteDelegate<sA>::Write(sampler_a, size, start, scale, output + plane * 3);
+      }
+
+      size_t GetChannelKeys(const void** output) const override {
+        for (size_t i = 0; i < 4; i++) {
+          output[i] = keys[i];
+        }
+
+        return 4;
+      }
+
+      void WriteChannelRow(size_t channel, const glm::dvec2& start, double step, int count, float* output) const override {
+        glm::ivec2 size(count, 1);
+        glm::dvec2 scale(step);
+        switch (channel) {
+          case 0:
+            ChannelChunkWriteDelegate<sR>::Write(sampler_r, size, start, scale, output);
+            break;
+          case 1:
+            ChannelChunkWriteDelegate<sG>::Write(sampler_g, size, start, scale, output);
+            break;
+          case 2:
+            ChannelChunkWriteDelegate<sB>::Write(sampler_b, size, start, scale, output);
+            break;
+          default:
+            ChannelChunkWriteDelegate<sA>::Write(sampler_a, size, start, scale, output);
+            break;
+        }
+      }
       private:
       sR sampler_r;
       sG sampler_g;
       sB sampler_b;
       sA sampler_a;
+
+      // bound sampler objects, to spot samplers shared between layers
+      const void* keys[4];
     };
   }
 }
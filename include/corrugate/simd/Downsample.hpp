@@ -0,0 +1,217 @@
+#ifndef CG_DOWNSAMPLE_H_
+#define CG_DOWNSAMPLE_H_
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+
+// 2x reductions for building mip levels
+// - output sample i sits between input samples 2i and 2i + 1
+// - box: weights 1/2, 1/2 on 2i, 2i + 1
+// - binomial: weights 1/8, 3/8, 3/8, 1/8 on 2i - 1 .. 2i + 2 (a cheap gaussian)
+// - reads past either edge clamp to the edge sample, so odd widths work (the last output reuses the last input)
+
+namespace cg {
+  namespace simd {
+    // output width of a 2x reduction
+    inline int GetReducedSize(int size) {
+      return std::max((size + 1) / 2, 1);
+    }
+
+    namespace _impl {
+      // channels consecutive floats at clamped sample x
+      inline const float* GetClamped(const float* input, int width, int channels, int64_t x) {
+        return input + static_cast<size_t>(std::min(std::max(x, static_cast<int64_t>(0)), static_cast<int64_t>(width - 1))) * channels;
+      }
+
+      inline void ReduceRowBoxScalar(const float* input, int width, int channels, int begin, int end, float* output) {
+        for (int i = begin; i < end; i++) {
+          const float* a = GetClamped(input, width, channels, 2 * static_cast<int64_t>(i));
+          const float* b = GetClamped(input, width, channels, 2 * static_cast<int64_t>(i) + 1);
+          for (int c = 0; c < channels; c++) {
+            output[i * channels + c] = (a[c] + b[c]) * 0.5f;
+          }
+        }
+      }
+
+      inline void ReduceRowBinomialScalar(const float* input, int width, int channels, int begin, int end, float* output) {
+        for (int i = begin; i < end; i++) {
+          const float* a = GetClamped(input, width, channels, 2 * static_cast<int64_t>(i) - 1);
+          const float* b = GetClamped(input, width, channels, 2 * static_cast<int64_t>(i));
+          const float* c = GetClamped(input, width, channels, 2 * static_cast<int64_t>(i) + 1);
+          const float* d = GetClamped(input, width, channels, 2 * static_cast<int64_t>(i) + 2);
+          for (int k = 0; k < channels; k++) {
+            output[i * channels + k] = (a[k] + d[k]) * 0.125f + (b[k] + c[k]) * 0.375f;
+          }
+        }
+      }
+    }
+
+    /**
+     * @brief Box-reduces a row of samples along x.
+     *
+     * @param input - width samples, channels floats each
+     * @param width - input samples
+     * @param channels - floats per sample (1 or 4 are vectorized)
+     * @param output - GetReducedSize(width) samples
+     */
+    inline void ReduceRowBox(const float* input, int width, int channels, float* output) {
+      int out_width = GetReducedSize(width);
+      // outputs which only read inside the row
+      int inner = width / 2;
+      int i = 0;
+
+#if defined(__SSE2__)
+      __m128 half = _mm_set1_ps(0.5f);
+      if (channels == 1) {
+        for (; i + 4 <= inner; i += 4) {
+          __m128 lo = _mm_loadu_ps(input + 2 * i);
+          __m128 hi = _mm_loadu_ps(input + 2 * i + 4);
+          __m128 even = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+          __m128 odd = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+          _mm_storeu_ps(output + i, _mm_mul_ps(_mm_add_ps(even, odd), half));
+        }
+      } else if (channels == 4) {
+        for (; i < inner; i++) {
+          __m128 a = _mm_loadu_ps(input + 8 * i);
+          __m128 b = _mm_loadu_ps(input + 8 * i + 4);
+          _mm_storeu_ps(output + 4 * i, _mm_mul_ps(_mm_add_ps(a, b), half));
+        }
+      }
+#elif defined(__ARM_NEON)
+      if (channels == 1) {
+        for (; i + 4 <= inner; i += 4) {
+          float32x4x2_t pairs = vld2q_f32(input + 2 * i);
+          vst1q_f32(output + i, vmulq_n_f32(vaddq_f32(pairs.val[0], pairs.val[1]), 0.5f));
+        }
+      } else if (channels == 4) {
+        for (; i < inner; i++) {
+          float32x4_t a = vld1q_f32(input + 8 * i);
+          float32x4_t b = vld1q_f32(input + 8 * i + 4);
+          vst1q_f32(output + 4 * i, vmulq_n_f32(vaddq_f32(a, b), 0.5f));
+        }
+      }
+#endif
+
+      _impl::ReduceRowBoxScalar(input, width, channels, i, out_width, output);
+    }
+
+    /**
+     * @brief Binomial-reduces a row of samples along x - see ReduceRowBox.
+     */
+    inline void ReduceRowBinomial(const float* input, int width, int channels, float* output) {
+      int out_width = GetReducedSize(width);
+      // first output which doesn't read before the row
+      int i = std::min(1, out_width);
+      _impl::ReduceRowBinomialScalar(input, width, channels, 0, i, output);
+
+      // outputs up to (not including) inner only read inside the row
+      int inner = std::max((width - 1) / 2, i);
+
+#if defined(__SSE2__)
+      __m128 outer_weight = _mm_set1_ps(0.125f);
+      __m128 inner_weight = _mm_set1_ps(0.375f);
+      if (channels == 1) {
+        // taps from two loads: evens / odds of [2i - 1, 2i + 6] and [2i + 1, 2i + 8]
+        for (; i + 4 <= inner; i += 4) {
+          __m128 lo = _mm_loadu_ps(input + 2 * i - 1);
+          __m128 hi = _mm_loadu_ps(input + 2 * i + 3);
+          __m128 a = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+          __m128 b = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+          lo = _mm_loadu_ps(input + 2 * i + 1);
+          hi = _mm_loadu_ps(input + 2 * i + 5);
+          __m128 c = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+          __m128 d = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+          __m128 res = _mm_add_ps(_mm_mul_ps(_mm_add_ps(a, d), outer_weight), _mm_mul_ps(_mm_add_ps(b, c), inner_weight));
+          _mm_storeu_ps(output + i, res);
+        }
+      } else if (channels == 4) {
+        for (; i < inner; i++) {
+          const float* base = input + 8 * i;
+          __m128 a = _mm_loadu_ps(base - 4);
+          __m128 b = _mm_loadu_ps(base);
+          __m128 c = _mm_loadu_ps(base + 4);
+          __m128 d = _mm_loadu_ps(base + 8);
+          __m128 res = _mm_add_ps(_mm_mul_ps(_mm_add_ps(a, d), outer_weight), _mm_mul_ps(_mm_add_ps(b, c), inner_weight));
+          _mm_storeu_ps(output + 4 * i, res);
+        }
+      }
+#elif defined(__ARM_NEON)
+      if (channels == 1) {
+        for (; i + 4 <= inner; i += 4) {
+          float32x4x2_t ab = vld2q_f32(input + 2 * i - 1);
+          float32x4x2_t cd = vld2q_f32(input + 2 * i + 1);
+          float32x4_t res = vmulq_n_f32(vaddq_f32(ab.val[0], cd.val[1]), 0.125f);
+          res = vmlaq_n_f32(res, vaddq_f32(ab.val[1], cd.val[0]), 0.375f);
+          vst1q_f32(output + i, res);
+        }
+      } else if (channels == 4) {
+        for (; i < inner; i++) {
+          const float* base = input + 8 * i;
+          float32x4_t res = vmulq_n_f32(vaddq_f32(vld1q_f32(base - 4), vld1q_f32(base + 8)), 0.125f);
+          res = vmlaq_n_f32(res, vaddq_f32(vld1q_f32(base), vld1q_f32(base + 4)), 0.375f);
+          vst1q_f32(output + 4 * i, res);
+        }
+      }
+#endif
+
+      _impl::ReduceRowBinomialScalar(input, width, channels, i, out_width, output);
+    }
+
+    /**
+     * @brief Box-reduces two rows along y: output = (a + b) / 2.
+     */
+    inline void ReduceColumnsBox(const float* a, const float* b, int count, float* output) {
+      int i = 0;
+
+#if defined(__SSE2__)
+      __m128 half = _mm_set1_ps(0.5f);
+      for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)), half));
+      }
+#elif defined(__ARM_NEON)
+      for (; i + 4 <= count; i += 4) {
+        vst1q_f32(output + i, vmulq_n_f32(vaddq_f32(vld1q_f32(a + i), vld1q_f32(b + i)), 0.5f));
+      }
+#endif
+
+      for (; i < count; i++) {
+        output[i] = (a[i] + b[i]) * 0.5f;
+      }
+    }
+
+    /**
+     * @brief Binomial-reduces four rows along y: output = (a + d) / 8 + (b + c) * 3 / 8.
+     */
+    inline void ReduceColumnsBinomial(const float* a, const float* b, const float* c, const float* d, int count, float* output) {
+      int i = 0;
+
+#if defined(__SSE2__)
+      __m128 outer_weight = _mm_set1_ps(0.125f);
+      __m128 inner_weight = _mm_set1_ps(0.375f);
+      for (; i + 4 <= count; i += 4) {
+        __m128 outer = _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(d + i));
+        __m128 inner = _mm_add_ps(_mm_loadu_ps(b + i), _mm_loadu_ps(c + i));
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_mul_ps(outer, outer_weight), _mm_mul_ps(inner, inner_weight)));
+      }
+#elif defined(__ARM_NEON)
+      for (; i + 4 <= count; i += 4) {
+        float32x4_t res = vmulq_n_f32(vaddq_f32(vld1q_f32(a + i), vld1q_f32(d + i)), 0.125f);
+        res = vmlaq_n_f32(res, vaddq_f32(vld1q_f32(b + i), vld1q_f32(c + i)), 0.375f);
+        vst1q_f32(output + i, res);
+      }
+#endif
+
+      for (; i < count; i++) {
+        output[i] = (a[i] + d[i]) * 0.125f + (b[i] + c[i]) * 0.375f;
+      }
+    }
+  }
+}
+
+#endif // CG_DOWNSAMPLE_H_
@@ -0,0 +1,132 @@
+#ifndef CG_FALLOFF_KERNEL_H_
+#define CG_FALLOFF_KERNEL_H_
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+namespace cg {
+  namespace simd {
+    /**
+     * @brief Parameters for one row of falloff weights (see FeatureBox::GetFalloffWeight_local).
+     *        Sample i sits at normalized x = offset + i * step - the row's normalized y is fixed.
+     */
+    struct FalloffRow {
+      // normalized x of the first sample
+      float offset;
+      // normalized distance between samples
+      float step;
+      // |normalized y| for the whole row
+      float dist_y;
+      // dist at which falloff begins
+      float falloff_start;
+      // 1 / (1 - falloff_start)
+      float inv_falloff_range;
+    };
+
+    namespace _impl {
+      inline float FalloffScalar(const FalloffRow& row, int i) {
+        float dist = std::max(std::abs(row.offset + static_cast<float>(i) * row.step), row.dist_y);
+        float t = std::min(std::max((dist - row.falloff_start) * row.inv_falloff_range, 0.0f), 1.0f);
+        return 1.0f - t * t * (3.0f - 2.0f * t);
+      }
+    }
+
+    /**
+     * @brief Writes (or adds, if Accumulate) count falloff weights to output.
+     */
+    template <bool Accumulate>
+    inline void WriteFalloffRow(const FalloffRow& row, int count, float* output) {
+      int i = 0;
+
+#if defined(__AVX__)
+      const __m256 offset = _mm256_set1_ps(row.offset);
+      const __m256 step = _mm256_set1_ps(row.step);
+      const __m256 dist_y = _mm256_set1_ps(row.dist_y);
+      const __m256 start = _mm256_set1_ps(row.falloff_start);
+      const __m256 inv_range = _mm256_set1_ps(row.inv_falloff_range);
+      const __m256 zero = _mm256_setzero_ps();
+      const __m256 one = _mm256_set1_ps(1.0f);
+      const __m256 two = _mm256_set1_ps(2.0f);
+      const __m256 three = _mm256_set1_ps(3.0f);
+      const __m256 sign = _mm256_set1_ps(-0.0f);
+      __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+      const __m256 lane_step = _mm256_set1_ps(8.0f);
+
+      for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_andnot_ps(sign, _mm256_add_ps(offset, _mm256_mul_ps(lane, step)));
+        __m256 dist = _mm256_max_ps(x, dist_y);
+        __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(dist, start), inv_range), zero), one);
+        __m256 w = _mm256_sub_ps(one, _mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_sub_ps(three, _mm256_mul_ps(two, t))));
+        if (Accumulate) {
+          w = _mm256_add_ps(w, _mm256_loadu_ps(output + i));
+        }
+
+        _mm256_storeu_ps(output + i, w);
+        lane = _mm256_add_ps(lane, lane_step);
+      }
+#elif defined(__SSE2__)
+      const __m128 offset = _mm_set1_ps(row.offset);
+      const __m128 step = _mm_set1_ps(row.step);
+      const __m128 dist_y = _mm_set1_ps(row.dist_y);
+      const __m128 start = _mm_set1_ps(row.falloff_start);
+      const __m128 inv_range = _mm_set1_ps(row.inv_falloff_range);
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 one = _mm_set1_ps(1.0f);
+      const __m128 two = _mm_set1_ps(2.0f);
+      const __m128 three = _mm_set1_ps(3.0f);
+      const __m128 sign = _mm_set1_ps(-0.0f);
+      __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+      const __m128 lane_step = _mm_set1_ps(4.0f);
+
+      for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_andnot_ps(sign, _mm_add_ps(offset, _mm_mul_ps(lane, step)));
+        __m128 dist = _mm_max_ps(x, dist_y);
+        __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(dist, start), inv_range), zero), one);
+        __m128 w = _mm_sub_ps(one, _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(three, _mm_mul_ps(two, t))));
+        if (Accumulate) {
+          w = _mm_add_ps(w, _mm_loadu_ps(output + i));
+        }
+
+        _mm_storeu_ps(output + i, w);
+        lane = _mm_add_ps(lane, lane_step);
+      }
+#elif defined(__ARM_NEON)
+      const float32x4_t offset = vdupq_n_f32(row.offset);
+      const float32x4_t dist_y = vdupq_n_f32(row.dist_y);
+      const float32x4_t start = vdupq_n_f32(row.falloff_start);
+      const float32x4_t zero = vdupq_n_f32(0.0f);
+      const float32x4_t one = vdupq_n_f32(1.0f);
+      const float32x4_t three = vdupq_n_f32(3.0f);
+      const float lane_init[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+      float32x4_t lane = vld1q_f32(lane_init);
+      const float32x4_t lane_step = vdupq_n_f32(4.0f);
+
+      for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vabsq_f32(vaddq_f32(offset, vmulq_n_f32(lane, row.step)));
+        float32x4_t dist = vmaxq_f32(x, dist_y);
+        float32x4_t t = vminq_f32(vmaxq_f32(vmulq_n_f32(vsubq_f32(dist, start), row.inv_falloff_range), zero), one);
+        float32x4_t w = vsubq_f32(one, vmulq_f32(vmulq_f32(t, t), vsubq_f32(three, vmulq_n_f32(t, 2.0f))));
+        if (Accumulate) {
+          w = vaddq_f32(w, vld1q_f32(output + i));
+        }
+
+        vst1q_f32(output + i, w);
+        lane = vaddq_f32(lane, lane_step);
+      }
+#endif
+
+      for (; i < count; i++) {
+        float w = _impl::FalloffScalar(row, i);
+        output[i] = (Accumulate ? output[i] + w : w);
+      }
+    }
+  }
+}
+
+#endif // CG_FALLOFF_KERNEL_H_
@@ -0,0 +1,96 @@
+#ifndef CG_INTERLEAVE_H_
+#define CG_INTERLEAVE_H_
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cg {
+  namespace simd {
+    /**
+     * @brief Interleaves four channel rows into rgba.
+     *
+     * @param r, g, b, a - channel inputs (count floats each)
+     * @param count - number of pixels
+     * @param output - rgba output (count * 4 floats)
+     */
+    inline void Interleave4(const float* r, const float* g, const float* b, const float* a, int count, float* output) {
+      int i = 0;
+
+#if defined(__SSE2__)
+      // 4x4 transpose - four pixels per iteration
+      for (; i + 4 <= count; i += 4) {
+        __m128 c0 = _mm_loadu_ps(r + i);
+        __m128 c1 = _mm_loadu_ps(g + i);
+        __m128 c2 = _mm_loadu_ps(b + i);
+        __m128 c3 = _mm_loadu_ps(a + i);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        _mm_storeu_ps(output + i * 4, c0);
+        _mm_storeu_ps(output + i * 4 + 4, c1);
+        _mm_storeu_ps(output + i * 4 + 8, c2);
+        _mm_storeu_ps(output + i * 4 + 12, c3);
+      }
+#elif defined(__ARM_NEON)
+      for (; i + 4 <= count; i += 4) {
+        float32x4x4_t pixels;
+        pixels.val[0] = vld1q_f32(r + i);
+        pixels.val[1] = vld1q_f32(g + i);
+        pixels.val[2] = vld1q_f32(b + i);
+        pixels.val[3] = vld1q_f32(a + i);
+        vst4q_f32(output + i * 4, pixels);
+      }
+#endif
+
+      for (; i < count; i++) {
+        output[i * 4]     = r[i];
+        output[i * 4 + 1] = g[i];
+        output[i * 4 + 2] = b[i];
+        output[i * 4 + 3] = a[i];
+      }
+    }
+
+    /**
+     * @brief Splits rgba into four channel rows.
+     *
+     * @param input - rgba input (count * 4 floats)
+     * @param count - number of pixels
+     * @param r, g, b, a - channel outputs (count floats each)
+     */
+    inline void Deinterleave4(const float* input, int count, float* r, float* g, float* b, float* a) {
+      int i = 0;
+
+#if defined(__SSE2__)
+      for (; i + 4 <= count; i += 4) {
+        __m128 p0 = _mm_loadu_ps(input + i * 4);
+        __m128 p1 = _mm_loadu_ps(input + i * 4 + 4);
+        __m128 p2 = _mm_loadu_ps(input + i * 4 + 8);
+        __m128 p3 = _mm_loadu_ps(input + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        _mm_storeu_ps(r + i, p0);
+        _mm_storeu_ps(g + i, p1);
+        _mm_storeu_ps(b + i, p2);
+        _mm_storeu_ps(a + i, p3);
+      }
+#elif defined(__ARM_NEON)
+      for (; i + 4 <= count; i += 4) {
+        float32x4x4_t pixels = vld4q_f32(input + i * 4);
+        vst1q_f32(r + i, pixels.val[0]);
+        vst1q_f32(g + i, pixels.val[1]);
+        vst1q_f32(b + i, pixels.val[2]);
+        vst1q_f32(a + i, pixels.val[3]);
+      }
+#endif
+
+      for (; i < count; i++) {
+        r[i] = input[i * 4];
+        g[i] = input[i * 4 + 1];
+        b[i] = input[i * 4 + 2];
+        a[i] = input[i * 4 + 3];
+      }
+    }
+  }
+}
+
+#endif // CG_INTERLEAVE_H_
@@ -0,0 +1,184 @@
+#ifndef CG_QUANTIZE_H_
+#define CG_QUANTIZE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace cg {
+  namespace simd {
+    /**
+     * @brief Converts a float to an ieee half (round to nearest even, inf / nan preserved).
+     */
+    inline uint16_t FloatToHalf(float value) {
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+
+      uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+      uint32_t abs = bits & 0x7fffffff;
+
+      if (abs >= 0x7f800000) {
+        // inf / nan (keep nans quiet)
+        return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+      }
+
+      if (abs >= 0x477ff000) {
+        // 65520 and up rounds to inf
+        return sign | 0x7c00;
+      }
+
+      if (abs < 0x38800000) {
+        // half subnormal (below 2^-14) - anything under 2^-25 rounds to 0
+        if (abs < 0x33000000) {
+          return sign;
+        }
+
+        uint32_t mant = (abs & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - (abs >> 23);
+        uint32_t res = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (res & 1))) {
+          res++;
+        }
+
+        return sign | static_cast<uint16_t>(res);
+      }
+
+      // rebias exponent (127 -> 15), then round off 13 mantissa bits
+      uint32_t rebiased = abs - 0x38000000;
+      uint32_t res = rebiased >> 13;
+      uint32_t rem = rebiased & 0x1fff;
+      if (rem > 0x1000 || (rem == 0x1000 && (res & 1))) {
+        res++;
+      }
+
+      return sign | static_cast<uint16_t>(res);
+    }
+
+    inline float HalfToFloat(uint16_t value) {
+      uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+      uint32_t exp = (value >> 10) & 0x1f;
+      uint32_t mant = value & 0x3ff;
+
+      uint32_t bits;
+      if (exp == 0x1f) {
+        bits = sign | 0x7f800000 | (mant << 13);
+      } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+      } else if (mant != 0) {
+        // subnormal - normalize
+        exp = 113;
+        while ((mant & 0x400) == 0) {
+          mant <<= 1;
+          exp--;
+        }
+
+        bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+      } else {
+        bits = sign;
+      }
+
+      float res;
+      memcpy(&res, &bits, sizeof(res));
+      return res;
+    }
+
+    /**
+     * @brief Maps [min, max] to normalized uint16 (clamped, round to nearest).
+     *
+     * @param input - float input (count floats)
+     * @param count - number of values
+     * @param min - value written as 0
+     * @param max - value written as 65535
+     * @param output - uint16 output (count values)
+     */
+    inline void QuantizeUnorm16(const float* input, int count, float min, float max, uint16_t* output) {
+      float range = max - min;
+      float mul = (range != 0.0f ? 65535.0f / range : 0.0f);
+      float add = -min * mul;
+      int i = 0;
+
+#if defined(__SSE2__)
+      __m128 v_mul = _mm_set1_ps(mul);
+      __m128 v_add = _mm_set1_ps(add);
+      __m128 v_zero = _mm_setzero_ps();
+      __m128 v_max = _mm_set1_ps(65535.0f);
+      // no unsigned 32 -> 16 pack in sse2: shift into signed range, pack, shift back
+      __m128i v_bias = _mm_set1_epi32(32768);
+      __m128i v_flip = _mm_set1_epi16(static_cast<short>(0x8000));
+      for (; i + 8 <= count; i += 8) {
+        __m128 lo = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(input + i), v_mul), v_add);
+        __m128 hi = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(input + i + 4), v_mul), v_add);
+        lo = _mm_min_ps(_mm_max_ps(lo, v_zero), v_max);
+        hi = _mm_min_ps(_mm_max_ps(hi, v_zero), v_max);
+        __m128i lo_i = _mm_sub_epi32(_mm_cvtps_epi32(lo), v_bias);
+        __m128i hi_i = _mm_sub_epi32(_mm_cvtps_epi32(hi), v_bias);
+        __m128i packed = _mm_xor_si128(_mm_packs_epi32(lo_i, hi_i), v_flip);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), packed);
+      }
+#endif
+
+      for (; i < count; i++) {
+        float v = std::min(std::max(input[i] * mul + add, 0.0f), 65535.0f);
+        output[i] = static_cast<uint16_t>(std::nearbyint(v));
+      }
+    }
+
+    /**
+     * @brief Converts floats to ieee halves.
+     */
+    inline void QuantizeHalf(const float* input, int count, uint16_t* output) {
+      int i = 0;
+
+#if defined(__F16C__)
+      for (; i + 4 <= count; i += 4) {
+        __m128i halves = _mm_cvtps_ph(_mm_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i), halves);
+      }
+#endif
+
+      for (; i < count; i++) {
+        output[i] = FloatToHalf(input[i]);
+      }
+    }
+
+    /**
+     * @brief Maps [0, 1] to normalized uint8 (clamped, round to nearest).
+     *        For rgba, pass count * 4.
+     */
+    inline void QuantizeUnorm8(const float* input, int count, uint8_t* output) {
+      int i = 0;
+
+#if defined(__SSE2__)
+      __m128 v_mul = _mm_set1_ps(255.0f);
+      __m128 v_zero = _mm_setzero_ps();
+      __m128 v_max = _mm_set1_ps(255.0f);
+      for (; i + 16 <= count; i += 16) {
+        __m128i q[4];
+        for (int k = 0; k < 4; k++) {
+          __m128 v = _mm_mul_ps(_mm_loadu_ps(input + i + k * 4), v_mul);
+          q[k] = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, v_zero), v_max));
+        }
+
+        // values are 0..255, so signed packs are lossless
+        __m128i lo = _mm_packs_epi32(q[0], q[1]);
+        __m128i hi = _mm_packs_epi32(q[2], q[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(lo, hi));
+      }
+#endif
+
+      for (; i < count; i++) {
+        float v = std::min(std::max(input[i] * 255.0f, 0.0f), 255.0f);
+        output[i] = static_cast<uint8_t>(std::nearbyint(v));
+      }
+    }
+  }
+}
+
+#endif // CG_QUANTIZE_H_
@@ -27,10 +27,103 @@ namespace cg {
         template <typename Writer, typename...>
         static std::false_type test(...);
       };
+
+      struct splat_layers_chunk_trait_impl {
+        template <typename Writer,
+        typename WriteFunc = std::is_same<
+          size_t,
+          decltype(
+            std::declval<const Writer&>().WriteSplatLayers(
+              std::declval<const glm::dvec2&>(),
+              std::declval<const glm::ivec2&>(),
+              (double)1.0,
+              (size_t)0,
+              (size_t)0,
+              std::declval<glm::vec4*>(),
+              (size_t)0
+            )
+          )>>
+        static std::true_type test(int);
+
+        template <typename Writer, typename...>
+        static std::false_type test(...);
+      };
+
+      struct channel_chunk_trait_impl {
+        template <typename Writer,
+        typename WriteFunc = decltype(
+          std::declval<const Writer&>().Write(
+            std::declval<const glm::ivec2&>(),
+            std::declval<const glm::dvec2&>(),
+            std::declval<const glm::dvec2&>(),
+            std::declval<float*>()
+          )
+        )>
+        static std::true_type test(int);
+
+        template <typename Writer, typename...>
+        static std::false_type test(...);
+      };
+
+      struct height_chunk_trait_impl {
+        template <typename Writer,
+        typename WriteFunc = std::is_same<
+          size_t,
+          decltype(
+            std::declval<const Writer&>().WriteHeight(
+              std::declval<const glm::dvec2&>(),
+              std::declval<const glm::ivec2&>(),
+              (double)1.0,
+              std::declval<float*>(),
+              (size_t)0
+            )
+          )>>
+        static std::true_type test(int);
+
+        template <typename Writer, typename...>
+        static std::false_type test(...);
+      };
+
+      struct tree_fill_chunk_trait_impl {
+        template <typename Writer,
+        typename WriteFunc = std::is_same<
+          size_t,
+          decltype(
+            std::declval<const Writer&>().WriteTreeFill(
+              std::declval<const glm::dvec2&>(),
+              std::declval<const glm::ivec2&>(),
+              (double)1.0,
+              std::declval<float*>(),
+              (size_t)0
+            )
+          )>>
+        static std::true_type test(int);
+
+        template <typename Writer, typename...>
+        static std::false_type test(...);
+      };
     }
 
     template <typename T>
     struct splat_chunk_trait : decltype(_impl::splat_chunk_trait_impl::test<T>(0)) {};
+
+    // size_t WriteSplatLayers(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, size_t first_index, size_t count, glm::vec4* output, size_t n_bytes) const
+    template <typename T>
+    struct splat_layers_chunk_trait : decltype(_impl::splat_layers_chunk_trait_impl::test<T>(0)) {};
+
+    // single channel splat sampler which can write a whole image
+    // void Write(const glm::ivec2& size, const glm::dvec2& start, const glm::dvec2& scale, float* output) const
+    // - sample (x, y) sits at start + scale * (x, y)
+    template <typename T>
+    struct channel_chunk_trait : decltype(_impl::channel_chunk_trait_impl::test<T>(0)) {};
+
+    // size_t WriteHeight(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) const
+    template <typename T>
+    struct height_chunk_trait : decltype(_impl::height_chunk_trait_impl::test<T>(0)) {};
+
+    // size_t WriteTreeFill(const glm::dvec2& origin, const glm::ivec2& sample_dims, double scale, float* output, size_t n_bytes) const
+    template <typename T>
+    struct tree_fill_chunk_trait : decltype(_impl::tree_fill_chunk_trait_impl::test<T>(0)) {};
   }
 }
 
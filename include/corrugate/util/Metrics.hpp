@@ -0,0 +1,192 @@
+#ifndef CG_METRICS_H_
+#define CG_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// define CG_ENABLE_METRICS (before including anything from corrugate) to record counters and stage timers
+// - off by default: the macros below expand to nothing, and Metrics::Get() reads all zeroes
+#ifdef CG_ENABLE_METRICS
+#define CG_METRICS_ENABLED 1
+#else
+#define CG_METRICS_ENABLED 0
+#endif
+
+namespace cg {
+  namespace metrics {
+    // counted events - bulk vs per-sample paths are per chunk (or block) write, not per sample
+    enum Counter : uint32_t {
+      COUNTER_HEIGHT_BULK,
+      COUNTER_HEIGHT_SINGLE,
+      COUNTER_SPLAT_BULK,
+      COUNTER_SPLAT_SINGLE,
+      COUNTER_SPLAT_LAYERS_BULK,
+      COUNTER_TREE_FILL_BULK,
+      COUNTER_TREE_FILL_SINGLE,
+      COUNTER_CHANNEL_BULK,
+      COUNTER_CHANNEL_SINGLE,
+      COUNTER_BOXES_WRITTEN,
+      COUNTER_BYTES_WRITTEN,
+      COUNTER_COUNT
+    };
+
+    // timed stages of a chunk write
+    enum Stage : uint32_t {
+      // finding boxes which overlap a block
+      STAGE_FETCH,
+      // falloff sums (chunk contexts)
+      STAGE_FALLOFF,
+      // box writes (samplers + falloff weights)
+      STAGE_SAMPLE,
+      // smoothing deltas
+      STAGE_SMOOTH,
+      // accruing box temps into outputs
+      STAGE_ACCUMULATE,
+      STAGE_COUNT
+    };
+
+    inline const char* GetName(Counter counter) {
+      static const char* names[COUNTER_COUNT] = {
+        "height_bulk",
+        "height_single",
+        "splat_bulk",
+        "splat_single",
+        "splat_layers_bulk",
+        "tree_fill_bulk",
+        "tree_fill_single",
+        "channel_bulk",
+        "channel_single",
+        "boxes_written",
+        "bytes_written"
+      };
+
+      return (counter < COUNTER_COUNT ? names[counter] : "unknown");
+    }
+
+    inline const char* GetName(Stage stage) {
+      static const char* names[STAGE_COUNT] = {
+        "fetch",
+        "falloff",
+        "sample",
+        "smooth",
+        "accumulate"
+      };
+
+      return (stage < STAGE_COUNT ? names[stage] : "unknown");
+    }
+
+    /**
+     * @brief Point in time copy of every counter and stage timer.
+     *        Stages nest (sample runs inside a write which may also be timed), so times are not additive across stages.
+     */
+    struct Snapshot {
+      uint64_t counters[COUNTER_COUNT] = {};
+      uint64_t stage_ns[STAGE_COUNT] = {};
+      uint64_t stage_calls[STAGE_COUNT] = {};
+
+      uint64_t Get(Counter counter) const {
+        return counters[counter];
+      }
+
+      double GetSeconds(Stage stage) const {
+        return stage_ns[stage] * 1e-9;
+      }
+    };
+
+    /**
+     * @brief Process wide counters and stage timers.
+     *        Updates are relaxed atomics, made once per chunk or block rather than per sample,
+     *        so they're safe to record from pool threads.
+     */
+    class Metrics {
+     public:
+      static Metrics& Get() {
+        static Metrics metrics;
+        return metrics;
+      }
+
+      void Add(Counter counter, uint64_t count) {
+        counters_[counter].fetch_add(count, std::memory_order_relaxed);
+      }
+
+      void AddTime(Stage stage, uint64_t ns) {
+        stage_ns_[stage].fetch_add(ns, std::memory_order_relaxed);
+        stage_calls_[stage].fetch_add(1, std::memory_order_relaxed);
+      }
+
+      Snapshot GetSnapshot() const {
+        Snapshot res;
+        for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+          res.counters[i] = counters_[i].load(std::memory_order_relaxed);
+        }
+
+        for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+          res.stage_ns[i] = stage_ns_[i].load(std::memory_order_relaxed);
+          res.stage_calls[i] = stage_calls_[i].load(std::memory_order_relaxed);
+        }
+
+        return res;
+      }
+
+      void Reset() {
+        for (auto& counter : counters_) {
+          counter.store(0, std::memory_order_relaxed);
+        }
+
+        for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+          stage_ns_[i].store(0, std::memory_order_relaxed);
+          stage_calls_[i].store(0, std::memory_order_relaxed);
+        }
+      }
+
+      static constexpr bool IsEnabled() {
+        return CG_METRICS_ENABLED != 0;
+      }
+
+     private:
+      Metrics() {
+        Reset();
+      }
+
+      std::atomic<uint64_t> counters_[COUNTER_COUNT];
+      std::atomic<uint64_t> stage_ns_[STAGE_COUNT];
+      std::atomic<uint64_t> stage_calls_[STAGE_COUNT];
+    };
+
+    /**
+     * @brief Adds the time between construction and destruction to a stage.
+     */
+    class StageTimer {
+     public:
+      StageTimer(Stage stage) : stage_(stage), start_(std::chrono::steady_clock::now()) {}
+      ~StageTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        Metrics::Get().AddTime(stage_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+      }
+
+      StageTimer(const StageTimer&) = delete;
+      StageTimer& operator=(const StageTimer&) = delete;
+
+     private:
+      Stage stage_;
+      std::chrono::steady_clock::time_point start_;
+    };
+  }
+}
+
+#define _CG_METRIC_CONCAT_IMPL(a, b) a##b
+#define _CG_METRIC_CONCAT(a, b) _CG_METRIC_CONCAT_IMPL(a, b)
+
+#if CG_METRICS_ENABLED
+// CG_METRIC_ADD(COUNTER_BYTES_WRITTEN, bytes)
+#define CG_METRIC_ADD(counter, count) ::cg::metrics::Metrics::Get().Add(::cg::metrics::counter, static_cast<uint64_t>(count))
+// times the rest of the enclosing scope - CG_METRIC_STAGE(STAGE_SAMPLE)
+#define CG_METRIC_STAGE(stage) ::cg::metrics::StageTimer _CG_METRIC_CONCAT(_cg_stage_timer_, __LINE__)(::cg::metrics::stage)
+#else
+#define CG_METRIC_ADD(counter, count) ((void)0)
+#define CG_METRIC_STAGE(stage) ((void)0)
+#endif
+
+#endif // CG_METRICS_H_
@@ -0,0 +1,41 @@
+#ifndef CG_TEMP_FILE_H_
+#define CG_TEMP_FILE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+
+namespace cg {
+  namespace impl {
+    // random per process, counting up per call
+    inline uint64_t GetTempSuffix() {
+      static std::atomic<uint64_t> counter(0);
+      static const uint64_t seed = (static_cast<uint64_t>(std::random_device()()) << 32) ^ std::random_device()();
+      return seed + counter.fetch_add(1);
+    }
+  }
+
+  /**
+   * @brief Creates a temp file next to path, for writing and then renaming over path.
+   *        Names are unique per call, and opened exclusively, so concurrent writers (threads or processes)
+   *        never share a temp file - the last rename wins.
+   *
+   * @param path - final path
+   * @param temp_path - set to the temp file's path
+   * @return FILE* - open for binary writing, or null if no temp file could be created
+   */
+  inline FILE* OpenTempFile(const std::string& path, std::string& temp_path) {
+    FILE* file = nullptr;
+    for (int attempt = 0; file == nullptr && attempt < 8; attempt++) {
+      temp_path = path + ".tmp" + std::to_string(impl::GetTempSuffix());
+      // "x": fail rather than open a file someone else is writing
+      file = fopen(temp_path.c_str(), "wbx");
+    }
+
+    return file;
+  }
+}
+
+#endif // CG_TEMP_FILE_H_
@@ -0,0 +1,192 @@
+#ifndef CG_THREAD_POOL_H_
+#define CG_THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cg {
+  /**
+   * @brief Work-stealing thread pool.
+   *        Each worker owns a deque - it pops its own work LIFO (cache-warm), and steals FIFO
+   *        from the other workers when it runs dry.
+   */
+  class ThreadPool {
+   public:
+    typedef std::function<void()> task_type;
+
+    /**
+     * @param threads - worker count - 0 picks hardware concurrency
+     */
+    ThreadPool(size_t threads = 0) {
+      if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1U);
+      }
+
+      for (size_t i = 0; i < threads; i++) {
+        queues_.push_back(std::make_unique<Queue>());
+      }
+
+      for (size_t i = 0; i < threads; i++) {
+        workers_.emplace_back([this, i]() { WorkerLoop(i); });
+      }
+    }
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(sleep_lock_);
+        stopping_ = true;
+      }
+
+      sleep_cv_.notify_all();
+      for (auto& worker : workers_) {
+        worker.join();
+      }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t GetThreadCount() const {
+      return workers_.size();
+    }
+
+    // queues a task - from a worker, onto its own deque, otherwise round-robin
+    void Submit(task_type task) {
+      size_t queue = (CurrentWorker().pool == this ? CurrentWorker().index : (next_queue_++ % queues_.size()));
+
+      // count it before it's visible - a worker could pop and decrement before a later increment, wrapping pending_
+      pending_++;
+      {
+        std::lock_guard<std::mutex> lock(queues_[queue]->lock);
+        queues_[queue]->tasks.push_back(std::move(task));
+      }
+
+      {
+        // pairs w the predicate check in WorkerLoop - avoids a lost wakeup
+        std::lock_guard<std::mutex> lock(sleep_lock_);
+      }
+
+      sleep_cv_.notify_one();
+    }
+
+    /**
+     * @brief Runs func(i) for every i in [0, count) and waits for all of them.
+     *        The calling thread helps out while it waits, so this is safe to call from inside a task.
+     */
+    template <typename Func>
+    void ParallelFor(size_t count, Func&& func) {
+      if (count == 0) {
+        return;
+      }
+
+      struct Group {
+        std::atomic<size_t> remaining;
+        std::mutex lock;
+        std::condition_variable cv;
+      };
+
+      auto group = std::make_shared<Group>();
+      group->remaining = count;
+
+      for (size_t i = 0; i < count; i++) {
+        Submit([group, &func, i]() {
+          func(i);
+          if (--group->remaining == 0) {
+            std::lock_guard<std::mutex> lock(group->lock);
+            group->cv.notify_all();
+          }
+        });
+      }
+
+      while (group->remaining > 0) {
+        if (!RunOne(CurrentWorker().pool == this ? CurrentWorker().index : 0)) {
+          std::unique_lock<std::mutex> lock(group->lock);
+          group->cv.wait_for(lock, std::chrono::milliseconds(1), [&]() { return group->remaining == 0; });
+        }
+      }
+    }
+
+   private:
+    struct Queue {
+      std::mutex lock;
+      std::deque<task_type> tasks;
+    };
+
+    struct WorkerId {
+      const ThreadPool* pool = nullptr;
+      size_t index = 0;
+    };
+
+    static WorkerId& CurrentWorker() {
+      thread_local WorkerId id;
+      return id;
+    }
+
+    // own queue first (back), then steal (front)
+    bool RunOne(size_t home) {
+      task_type task;
+      for (size_t i = 0; i < queues_.size() && !task; i++) {
+        size_t queue = (home + i) % queues_.size();
+        std::lock_guard<std::mutex> lock(queues_[queue]->lock);
+        auto& tasks = queues_[queue]->tasks;
+        if (tasks.empty()) {
+          continue;
+        }
+
+        if (i == 0) {
+          task = std::move(tasks.back());
+          tasks.pop_back();
+        } else {
+          task = std::move(tasks.front());
+          tasks.pop_front();
+        }
+
+        pending_--;
+      }
+
+      if (!task) {
+        return false;
+      }
+
+      task();
+      return true;
+    }
+
+    void WorkerLoop(size_t index) {
+      CurrentWorker().pool = this;
+      CurrentWorker().index = index;
+
+      for (;;) {
+        if (RunOne(index)) {
+          continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_lock_);
+        sleep_cv_.wait(lock, [this]() { return stopping_ || pending_ > 0; });
+        if (stopping_ && pending_ == 0) {
+          return;
+        }
+      }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> next_queue_{0};
+
+    std::mutex sleep_lock_;
+    std::condition_variable sleep_cv_;
+    bool stopping_ = false;
+  };
+}
+
+#endif // CG_THREAD_POOL_H_
@@ -0,0 +1,157 @@
+#ifndef CG_WORKSPACE_H_
+#define CG_WORKSPACE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+#include <vector>
+
+// alignment for every allocation - keeps rows friendly to simd loads
+#define _WORKSPACE_ALIGNMENT 64
+// size of the first block
+#define _WORKSPACE_DEFAULT_BYTES (1 << 20)
+
+namespace cg {
+  /**
+   * @brief Scratch arena for chunk writes.
+   *        Allocations bump a pointer and are released in bulk when a Scope closes.
+   *        Blocks are kept around between uses - once the arena has grown to the largest chunk
+   *        it sees, further writes do no heap allocation at all.
+   *
+   *        Not thread safe - use one per thread (see Local()).
+   */
+  class Workspace {
+   public:
+    /**
+     * @brief Restores the workspace to its state at construction when it goes out of scope.
+     */
+    class Scope {
+     public:
+      Scope(Workspace& workspace) : workspace_(workspace), block_(workspace.current_), offset_(workspace.offset_) {}
+      ~Scope() {
+        workspace_.Release(block_, offset_);
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+
+     private:
+      Workspace& workspace_;
+      size_t block_;
+      size_t offset_;
+    };
+
+    Workspace() {}
+    Workspace(size_t initial_bytes) {
+      AddBlock(initial_bytes);
+    }
+
+    ~Workspace() {
+      for (auto& block : blocks_) {
+        std::free(block.data);
+      }
+    }
+
+    Workspace(const Workspace&) = delete;
+    Workspace& operator=(const Workspace&) = delete;
+
+    /**
+     * @brief Fetches uninitialized space for count elements. Valid until the enclosing Scope closes.
+     */
+    template <typename T>
+    T* Allocate(size_t count) {
+      static_assert(std::is_trivially_destructible_v<T>, "workspace never runs destructors");
+      return reinterpret_cast<T*>(AllocateBytes(count * sizeof(T)));
+    }
+
+    // per-thread workspace, for callers which don't pass their own
+    static Workspace& Local() {
+      thread_local Workspace workspace;
+      return workspace;
+    }
+
+    size_t GetCapacity() const {
+      size_t capacity = 0;
+      for (auto& block : blocks_) {
+        capacity += block.capacity;
+      }
+
+      return capacity;
+    }
+
+    // number of blocks ever allocated - should stop growing after warmup
+    size_t GetAllocationCount() const {
+      return allocation_count_;
+    }
+
+   private:
+    struct Block {
+      char* data;
+      size_t capacity;
+    };
+
+    void* AllocateBytes(size_t bytes) {
+      bytes = AlignUp(std::max(bytes, static_cast<size_t>(1)));
+
+      // try the current block, then any (free) blocks past it
+      while (current_ < blocks_.size()) {
+        if (offset_ + bytes <= blocks_[current_].capacity) {
+          void* res = blocks_[current_].data + offset_;
+          offset_ += bytes;
+          return res;
+        }
+
+        if (current_ + 1 >= blocks_.size()) {
+          break;
+        }
+
+        current_++;
+        offset_ = 0;
+      }
+
+      size_t last = (blocks_.empty() ? 0 : blocks_.back().capacity);
+      AddBlock(std::max(bytes, std::max(last * 2, static_cast<size_t>(_WORKSPACE_DEFAULT_BYTES))));
+      current_ = blocks_.size() - 1;
+      offset_ = bytes;
+      return blocks_[current_].data;
+    }
+
+    void Release(size_t block, size_t offset) {
+      current_ = block;
+      offset_ = offset;
+
+      // fully released w more than one block - merge so the next pass fits in one
+      if (current_ == 0 && offset_ == 0 && blocks_.size() > 1) {
+        size_t capacity = GetCapacity();
+        for (auto& b : blocks_) {
+          std::free(b.data);
+        }
+
+        blocks_.clear();
+        AddBlock(capacity);
+      }
+    }
+
+    void AddBlock(size_t bytes) {
+      bytes = AlignUp(bytes);
+      Block block;
+      block.data = static_cast<char*>(std::aligned_alloc(_WORKSPACE_ALIGNMENT, bytes));
+      block.capacity = bytes;
+      blocks_.push_back(block);
+      allocation_count_++;
+    }
+
+    static size_t AlignUp(size_t bytes) {
+      return (bytes + (_WORKSPACE_ALIGNMENT - 1)) & ~static_cast<size_t>(_WORKSPACE_ALIGNMENT - 1);
+    }
+
+    std::vector<Block> blocks_;
+    size_t current_ = 0;
+    size_t offset_ = 0;
+    size_t allocation_count_ = 0;
+  };
+}
+
+#endif // CG_WORKSPACE_H_